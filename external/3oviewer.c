@@ -25,7 +25,8 @@
 // • Top‐left controls each on its own line
 // • F1 toggles all on‐screen text overlays
 // • All prior functionality retained
-// • x86_64-w64-mingw32-gcc -std=c99 -O2 -I./ -L./lib -o 3oviewer.exe viewer120.c -lfreeglut -lopengl32 -lglu32 -lwinmm
+// • Right click picks a face (BVH over the shown frame, refit per tick)
+// • x86_64-w64-mingw32-gcc -std=c99 -O2 -I./ -I./include -L./lib -o 3oviewer.exe viewer120.c -lfreeglut -lopengl32 -lglu32 -lwinmm
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -33,7 +34,9 @@
 #include <stdbool.h>
 #include <limits.h>
 #include <math.h>
+#include <time.h>
 #include <GL/freeglut.h>
+#include <chasm/chasm.h>
 
 #ifndef GL_CLAMP_TO_EDGE
 #define GL_CLAMP_TO_EDGE GL_CLAMP
@@ -45,12 +48,6 @@
 #define max(a,b) (((a)>(b))?(a):(b))
 #endif
 
-#define OFF_POLY   0x0000
-#define OFF_VERT   0x3200
-#define OFF_VCNT   0x4800
-#define OFF_PCNT   0x4802
-#define OFF_SKH    0x4804
-#define OFF_SKIN   0x4806
 #define SKIN_W     64
 static const float SCALE3O = 1.0f/2048.0f;
 
@@ -65,23 +62,36 @@ typedef struct {
 typedef struct { int16_t x,y,z; } VERT;
 #pragma pack(pop)
 
-// Raw buffers
-static uint8_t *raw3o = NULL, *rawAni = NULL;
-static size_t   size3o, sizeAni;
+// Model & optional .ANI frames, owned by the library
+static model mdl;
 
 // Palette & texture
-static uint8_t  palette[256][3];
+static uint8_t  paletteRGB[256][3];
 static GLuint   texID;
 static uint16_t skinH;
 static size_t   skinPixels;
 
 // Mesh & animation
 static POLY    *polys     = NULL;
-static VERT    *baseVerts = NULL;
 static uint16_t vcount, pcount;
-static VERT    *animVerts = NULL;
 static int      totalFrames = 0;
 
+// Animation ticks: TICKS_PER_FRAME interpolation steps between keyframes
+#define TICKS_PER_FRAME 16
+
+// One worker evaluates the model into a triple buffer, display shows the newest tick
+static anim_pool   *pool  = NULL;
+static anim_output *shown = NULL;
+static int          lastTick = 0;
+
+// Face picking: library BVH over the shown tick, topology built once, bounds refit per tick
+static bvh     *faceTree = NULL;
+static int      bvhTick  = -1;
+static GLdouble pickMV[16], pickPR[16];
+static GLint    pickVP[4];
+static int      pickedFace = -1, pickedHalf;
+static float    pickedT, pickedU, pickedV, pickUsec;
+
 // Model center
 static float centerX, centerY, centerZ;
 
@@ -122,13 +132,6 @@ static void drawText(const char *s,int x,int y){
 	glRasterPos2i(x,y);
 	while(*s) glutBitmapCharacter(GLUT_BITMAP_HELVETICA_10,*s++);
 }
-static void computeNormal(const float a[3],const float b[3],const float c[3], float n[3]){
-	float ux=b[0]-a[0], uy=b[1]-a[1], uz=b[2]-a[2];
-	float vx=c[0]-a[0], vy=c[1]-a[1], vz=c[2]-a[2];
-	n[0]=uy*vz-uz*vy; n[1]=uz*vx-ux*vz; n[2]=ux*vy-uy*vx;
-	float L=sqrtf(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
-	if(L>0){ n[0]/=L; n[1]/=L; n[2]/=L; }
-}
 static inline bool skipPoly(uint8_t flags, bool needTrans){
 	if(filterBit>=0 && !(flags & (1<<filterBit))) return true;
 	bool t2 = (flags & 4)!=0;
@@ -144,7 +147,7 @@ static void loadPalette(const char *fn){
 	fseek(f,0,SEEK_END);
 	long sz = ftell(f);
 	fseek(f,sz-768,SEEK_SET);
-	fread(palette,1,768,f);
+	fread(paletteRGB,1,768,f);
 	fclose(f);
 }
 
@@ -158,22 +161,19 @@ static void updateFilter(){
 
 // Load .3O mesh + skin
 static void load3O(const char *fn){
-	FILE *f = fopen(fn,"rb");
-	if(!f)
-	{
-		perror(fn);
+	mdl = csm_model_create_fn(fn);
+	if(mdl.fmt != CHASM_FORMAT_3O){
+		fprintf(stderr,"%s: not a .3O model\n",fn);
 		exit(1);
 	}
-	fseek(f,0,SEEK_END); size3o = ftell(f); fseek(f,0,SEEK_SET);
-	raw3o = malloc(size3o); fread(raw3o,1,size3o,f); fclose(f);
 
-	vcount = *(uint16_t*)(raw3o + OFF_VCNT);
-	pcount = *(uint16_t*)(raw3o + OFF_PCNT);
-	skinH  = *(uint16_t*)(raw3o + OFF_SKH);
+	vcount = mdl.c3o->vcount;
+	pcount = mdl.c3o->fcount;
+	skinH  = mdl.th;
 	skinPixels = SKIN_W * skinH;
 
 	// Compute center
-	VERT *vv = (VERT*)(raw3o + OFF_VERT);
+	VERT *vv = (VERT*)mdl.c3o->overt;
 	int16_t mnx=INT16_MAX, mxx=INT16_MIN,
 		mny=INT16_MAX, mxy=INT16_MIN,
 		mnz=INT16_MAX, mxz=INT16_MIN;
@@ -188,7 +188,7 @@ static void load3O(const char *fn){
 
 	// Dominant BG color
 	int hist[256] = {0};
-	uint8_t *skin = raw3o + OFF_SKIN;
+	uint8_t *skin = mdl.tdata;
 	for(size_t i=0;i<skinPixels;i++){
 		hist[skin[i]]++;
 	}
@@ -200,9 +200,9 @@ static void load3O(const char *fn){
 	uint8_t *rgba = malloc(skinPixels*4);
 	for(size_t i=0;i<skinPixels;i++){
 		uint8_t c = skin[i];
-		rgba[4*i+0] = palette[c][0];
-		rgba[4*i+1] = palette[c][1];
-		rgba[4*i+2] = palette[c][2];
+		rgba[4*i+0] = paletteRGB[c][0];
+		rgba[4*i+1] = paletteRGB[c][1];
+		rgba[4*i+2] = paletteRGB[c][2];
 		rgba[4*i+3] = (c==4?0:255);
 	}
 	glGenTextures(1,&texID);
@@ -214,27 +214,54 @@ static void load3O(const char *fn){
 	glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,SKIN_W,skinH,0,GL_RGBA,GL_UNSIGNED_BYTE,rgba);
 	free(rgba);
 
-	polys     = (POLY*)(raw3o + OFF_POLY);
-	baseVerts = (VERT*)(raw3o + OFF_VERT);
+	polys = (POLY*)mdl.c3o->faces;
 	updateFilter();
 }
 
-// Load .ANI animation
+// Load .ANI animation and mark vertices that move anywhere in it
 static void loadANI(const char *fn){
-	FILE *f = fopen(fn,"rb"); if(!f){ perror(fn); exit(1); }
-	fseek(f,0,SEEK_END); sizeAni = ftell(f); fseek(f,0,SEEK_SET);
-	rawAni = malloc(sizeAni); fread(rawAni,1,sizeAni,f); fclose(f);
-	size_t off = (*(uint16_t*)rawAni == vcount) ? 2 : 0;
-	totalFrames = (sizeAni - off) / (sizeof(VERT) * vcount);
-	animVerts   = (VERT*)(rawAni + off);
+	if(!csm_model_ani_create_fn(&mdl, fn)){
+		fprintf(stderr,"%s: no frames for this model\n",fn);
+		exit(1);
+	}
+	totalFrames = mdl.total_frames;
+	csm_model_motion_create(&mdl);
+}
+
+static void startWorker(){
+	pool = csm_anim_pool_create(&mdl, 1, 1, TICKS_PER_FRAME);
+	if(!pool){ fprintf(stderr,"animation worker unavailable\n"); exit(1); }
+}
+
+// Deterministic tick of the current frame & interpolation time
+static int currentTick(){
+	if(!totalFrames) return 0;
+	int sub = (playing && interpFrames) ? (int)(accTime/frameDur*TICKS_PER_FRAME) : 0;
+	return (curFrame % totalFrames)*TICKS_PER_FRAME + clampi(sub,0,TICKS_PER_FRAME-1);
+}
+
+// Unproject the click with the matrices of the last frame and pick against its tick
+static void pickAt(int x,int y){
+	GLdouble n[3], f[3];
+	gluUnProject(x+0.5, pickVP[3]-y-0.5, 0, pickMV, pickPR, pickVP, &n[0],&n[1],&n[2]);
+	gluUnProject(x+0.5, pickVP[3]-y-0.5, 1, pickMV, pickPR, pickVP, &f[0],&f[1],&f[2]);
+	float o[3]={n[0],n[1],n[2]}, d[3]={f[0]-n[0],f[1]-n[1],f[2]-n[2]};
+	struct timespec t0, t1;
+	timespec_get(&t0, TIME_UTC);
+	bvh_hit h = csm_bvh_raycast(faceTree, shown->pos, o, d, filterBit>=0 ? 1<<filterBit : 0);
+	timespec_get(&t1, TIME_UTC);
+	pickUsec   = (t1.tv_sec-t0.tv_sec)*1e6f + (t1.tv_nsec-t0.tv_nsec)*1e-3f;
+	pickedFace = h.hit ? (int)h.face : -1;
+	pickedHalf = h.half;
+	pickedT = h.t; pickedU = h.u; pickedV = h.v;
 }
 
 static void display(){
 	// Clear
 	glClearColor(
-			palette[bgIndex][0]/255.0f,
-			palette[bgIndex][1]/255.0f,
-			palette[bgIndex][2]/255.0f,1);
+			paletteRGB[bgIndex][0]/255.0f,
+			paletteRGB[bgIndex][1]/255.0f,
+			paletteRGB[bgIndex][2]/255.0f,1);
 	glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 
 	// Bit counts
@@ -252,6 +279,7 @@ static void display(){
 	gluLookAt(panX, panY, -zoom, panX, panY, 0, 0,1,0);
 	glRotatef(angleY,0,1,0); glRotatef(angleX,1,0,0);
 
+
 	// Lighting & culling
 	if(shading){
 		glEnable(GL_LIGHTING); glEnable(GL_LIGHT0); glEnable(GL_NORMALIZE);
@@ -263,17 +291,33 @@ static void display(){
 	}
 	if(doCull) glEnable(GL_CULL_FACE); else glDisable(GL_CULL_FACE);
 
+	// Model space after the light: centered, y/z swapped & scaled, the mirror is undone on the normals
+	static const GLfloat swapYZ[16] = { 1,0,0,0, 0,0,1,0, 0,1,0,0, 0,0,0,1 };
+	glScalef(SCALE3O,SCALE3O,SCALE3O);
+	glMultMatrixf(swapYZ);
+	glTranslatef(-centerX,-centerY,-centerZ);
+	glGetDoublev(GL_MODELVIEW_MATRIX, pickMV);
+	glGetDoublev(GL_PROJECTION_MATRIX, pickPR);
+	glGetIntegerv(GL_VIEWPORT, pickVP);
+
 	// Bind texture
 	glEnable(GL_TEXTURE_2D);
 	glBindTexture(GL_TEXTURE_2D, texID);
 
-	// Interpolate frames
-	int f0 = totalFrames ? curFrame % totalFrames : 0;
-	int f1 = totalFrames ? (f0+1) % totalFrames : 0;
-	float alpha = (playing && interpFrames && totalFrames)
-		? accTime/frameDur : 0;
-	VERT *v0 = totalFrames ? animVerts + f0*vcount : baseVerts;
-	VERT *v1 = totalFrames ? animVerts + f1*vcount : baseVerts;
+	// Interpolated frame from the worker, then let it prepare the expected next tick
+	int tick = currentTick();
+	shown = csm_anim_pool_output(pool, 0, tick);
+	if(totalFrames){
+		int ticks = totalFrames*TICKS_PER_FRAME;
+		int step  = (tick - lastTick + ticks) % ticks;
+		csm_anim_pool_request(pool, (tick + (step ? step : 1)) % ticks);
+	}
+	lastTick = tick;
+	float (*pos)[3] = (float (*)[3])shown->pos;
+	float (*nrm)[3] = (float (*)[3])shown->nrm;
+	if(bvhTick<0){ faceTree = csm_model_bvh_create(&mdl, shown->pos); csm_bvh_print(faceTree); }
+	else if(bvhTick != tick) csm_bvh_refit(faceTree, shown->pos);
+	bvhTick = tick;
 
 	// Two passes
 	for(int pass=0; pass<2; pass++){
@@ -300,18 +344,8 @@ static void display(){
 				glColor4f(1,1,1,1);
 			}
 
-			float A[3],B[3],C[3],n[3];
-			for(int k=0;k<3;k++){
-				VERT *va=&v0[P->vi[k]], *vb=&v1[P->vi[k]];
-				float x=(1-alpha)*(va->x-centerX)+alpha*(vb->x-centerX);
-				float y=(1-alpha)*(va->y-centerY)+alpha*(vb->y-centerY);
-				float z=(1-alpha)*(va->z-centerZ)+alpha*(vb->z-centerZ);
-				float vx=x*SCALE3O, vy=z*SCALE3O, vz=y*SCALE3O;
-				if(k==0){A[0]=vx;A[1]=vy;A[2]=vz;}
-				if(k==1){B[0]=vx;B[1]=vy;B[2]=vz;}
-				if(k==2){C[0]=vx;C[1]=vy;C[2]=vz;}
-			}
-			computeNormal(A,B,C,n); glNormal3fv(n);
+			float *A=pos[P->vi[0]], *B=pos[P->vi[1]], *C=pos[P->vi[2]];
+			glNormal3f(-nrm[i*2][0],-nrm[i*2][1],-nrm[i*2][2]);
 			for(int k=0;k<3;k++){
 				float u = P->uv[k][0]/(float)SKIN_W;
 				int vt = clampi(P->uv[k][1]+P->uv_off,0,skinH-1);
@@ -320,19 +354,9 @@ static void display(){
 			}
 			// Quad second triangle
 			if(P->vi[3]<vcount){
-				float D[3],E[3],Fv[3],n2[3];
 				int idx[3]={2,3,0};
-				for(int j=0;j<3;j++){
-					VERT *va=&v0[P->vi[idx[j]]], *vb=&v1[P->vi[idx[j]]];
-					float x=(1-alpha)*(va->x-centerX)+alpha*(vb->x-centerX);
-					float y=(1-alpha)*(va->y-centerY)+alpha*(vb->y-centerY);
-					float z=(1-alpha)*(va->z-centerZ)+alpha*(vb->z-centerZ);
-					float vx=x*SCALE3O, vy=z*SCALE3O, vz=y*SCALE3O;
-					if(j==0){D[0]=vx;D[1]=vy;D[2]=vz;}
-					if(j==1){E[0]=vx;E[1]=vy;E[2]=vz;}
-					if(j==2){Fv[0]=vx;Fv[1]=vy;Fv[2]=vz;}
-				}
-				computeNormal(D,E,Fv,n2); glNormal3fv(n2);
+				float *D=pos[P->vi[2]], *E=pos[P->vi[3]], *Fv=pos[P->vi[0]];
+				glNormal3f(-nrm[i*2+1][0],-nrm[i*2+1][1],-nrm[i*2+1][2]);
 				for(int j=0;j<3;j++){
 					float u = P->uv[idx[j]][0]/(float)SKIN_W;
 					int vt = clampi(P->uv[idx[j]][1]+P->uv_off,0,skinH-1);
@@ -349,6 +373,27 @@ static void display(){
 	if(shading) glDisable(GL_LIGHTING);
 	if(wireframe) glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
+	// Picked face outline, hit triangle filled, drawn over the model
+	if(pickedFace>=0){
+		POLY *P = &polys[pickedFace];
+		int n = P->vi[3]<vcount ? 4 : 3;
+		glLineWidth(2);
+		glColor3f(1,1,0);
+		glBegin(GL_LINE_LOOP);
+		for(int k=0;k<n;k++) glVertex3fv(pos[P->vi[k]]);
+		glEnd();
+		glLineWidth(1);
+		u16 vi[3]; csm_bvh_tri(faceTree, pickedFace*2+pickedHalf, vi);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
+		glColor4f(1,1,0,0.3f);
+		glBegin(GL_TRIANGLES);
+		for(int k=0;k<3;k++) glVertex3fv(pos[vi[k]]);
+		glEnd();
+		glDisable(GL_BLEND);
+		glColor3f(1,1,1);
+	}
+
 	// Texture preview
 	if(showTexPrev){
 		glMatrixMode(GL_PROJECTION); glPushMatrix(); glLoadIdentity();
@@ -374,6 +419,7 @@ static void display(){
 		glMatrixMode(GL_MODELVIEW); glPushMatrix(); glLoadIdentity();
 		int y = winH - 16;
 		drawText("Mouse drag: Rotate",10,y); y-=14;
+		drawText("Right click: Pick Face",10,y); y-=14;
 		drawText("Tab: Wireframe",10,y); y-=14;
 		drawText("W/S: Zoom",10,y); y-=14;
 		drawText("A/D: Rotate",10,y); y-=14;
@@ -426,6 +472,30 @@ static void display(){
 			drawText(buf,10,y);
 			y+=14;
 		}
+		// Picked face, bottom-right
+		if(pickedFace>=0){
+			POLY *P = &polys[pickedFace];
+			int x = winW - 260, n = P->vi[3]<vcount ? 4 : 3;
+			y = 10;
+			sprintf(buf,"hit t=%.3f  bary=(%.2f, %.2f)  pick %.1f us",pickedT,pickedU,pickedV,pickUsec);
+			drawText(buf,x,y); y+=14;
+			sprintf(buf,"uv_off: %d",P->uv_off);
+			drawText(buf,x,y); y+=14;
+			for(int k=n-1;k>=0;k--){
+				sprintf(buf,"v%d: %u  uv=(%u, %u)",k,P->vi[k],P->uv[k][0],P->uv[k][1]);
+				drawText(buf,x,y); y+=14;
+			}
+			sprintf(buf,"link.next: %u  link.distant: %u",P->link.next,P->link.distant);
+			drawText(buf,x,y); y+=14;
+			for(int b=7;b>=0;b--) if(P->conf.flags&(1<<b)){
+				sprintf(buf,"  bit %d: %s",b,bitDesc[b]);
+				drawText(buf,x,y); y+=14;
+			}
+			sprintf(buf,"conf.flags: 0x%02X  group: %u",P->conf.flags,P->conf.group);
+			drawText(buf,x,y); y+=14;
+			sprintf(buf,"Face %d/%u (%s, tri %d)",pickedFace,pcount,n==4?"quad":"tri",pickedHalf);
+			drawText(buf,x,y);
+		}
 		glMatrixMode(GL_PROJECTION); glPopMatrix();
 		glMatrixMode(GL_MODELVIEW);  glPopMatrix();
 	}
@@ -457,6 +527,7 @@ static void mouse(int b,int s,int x,int y){
 		mouseDown = (s==GLUT_DOWN);
 		lastMouseX = x; lastMouseY = y;
 	}
+	if(b==GLUT_RIGHT_BUTTON && s==GLUT_DOWN && faceTree) pickAt(x,y);
 }
 static void motion(int x,int y){
 	if(mouseDown){
@@ -487,6 +558,7 @@ static void keyboard(unsigned char k,int x,int y){
 				    interpFrames=true; showTexPrev=false; useLinear=false;
 				    zoom=1; angleY=0; angleX=0; panX=0; panY=0.05f;
 				    curFrame=0; accTime=0; bgIndex=defaultBgIndex; filterBit=-1;
+				    pickedFace=-1;
 				    updateFilter();
 				    break;
 		case '+':
@@ -528,6 +600,7 @@ int main(int argc,char**argv)
 	glutCreateWindow("Chasm The Rift 3O+ANI Viewer v1.2.1 by SMR9000");
 	load3O(argv[1]);
 	if(argc==3) loadANI(argv[2]);
+	startWorker();
 	glutDisplayFunc(display);
 	glutIdleFunc(idle);
 	glutReshapeFunc(reshape);
@@ -6,7 +6,9 @@
 #include <string.h>
 #include <strings.h>
 #include <GL/gl.h>
+#include <GL/glext.h>
 #include <GL/freeglut.h>
+#include <chasm/chasm.h>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -20,15 +22,15 @@
 
 #pragma pack(push,1)
 typedef struct {
-    struct AniMap { uint16_t model[20]; uint16_t submodel[6][2]; } anims;
-    struct GSND   { uint16_t id[3];                              } gsnd;
-    struct SFX    { uint16_t len[8];    uint16_t vol[8];         } sfx;
+    struct        { uint16_t model[20]; uint16_t submodel[6][2]; } anims;
+    struct        { uint16_t id[3];                              } gsnd;
+    struct        { uint16_t len[8];    uint16_t vol[8];         } sfx;
 } CARHeader;
 
 typedef struct {
     struct      { uint16_t vi[4]; uint16_t uv[4][2]; };
-    struct Link { uint16_t  next; uint16_t distant;  } link;
-    struct Conf {  uint8_t group;  uint8_t flags;    } conf;
+    struct      { uint16_t  next; uint16_t distant;  } link;
+    struct      {  uint8_t group;  uint8_t flags;    } conf;
     struct      { uint16_t uv_offset;                };
 } CARPolygon;
 
@@ -37,7 +39,8 @@ typedef struct { int16_t xyz[3]; } Vertex;
 
 static uint8_t *rawData = NULL;
 static size_t rawSize = 0;
-static uint8_t palette[256][3];
+static car_layout layout;
+static uint8_t palette_rgb[256][3];
 static uint8_t *textureRGBA = NULL;
 static uint16_t texWidth, texHeight;
 static Vertex *animationFrames = NULL;
@@ -52,6 +55,69 @@ static size_t animFrameIdx = 0;
 static CARPolygon *polygons = NULL;
 static GLuint texID;
 
+// per-animation moving vertex indices and cached interpolated frame
+static anim_motion animMotion[20];
+static float (*vertexCache)[3] = NULL;
+static size_t cacheF0 = SIZE_MAX, cacheF1 = SIZE_MAX;
+static float cacheAlpha = -1.0f;
+static int cacheAnim = -1;
+
+// GPU blending: all frames uploaded once as normalized shorts per unique (vertex,uv) corner,
+// the vertex shader lerps the f0/f1 streams, scales and centers
+#define GPU_PROCS(X) \
+    X(PFNGLCREATESHADERPROC,            glCreateShader) \
+    X(PFNGLSHADERSOURCEPROC,            glShaderSource) \
+    X(PFNGLCOMPILESHADERPROC,           glCompileShader) \
+    X(PFNGLGETSHADERIVPROC,             glGetShaderiv) \
+    X(PFNGLGETSHADERINFOLOGPROC,        glGetShaderInfoLog) \
+    X(PFNGLCREATEPROGRAMPROC,           glCreateProgram) \
+    X(PFNGLATTACHSHADERPROC,            glAttachShader) \
+    X(PFNGLDELETESHADERPROC,            glDeleteShader) \
+    X(PFNGLDELETEPROGRAMPROC,           glDeleteProgram) \
+    X(PFNGLBINDATTRIBLOCATIONPROC,      glBindAttribLocation) \
+    X(PFNGLLINKPROGRAMPROC,             glLinkProgram) \
+    X(PFNGLGETPROGRAMIVPROC,            glGetProgramiv) \
+    X(PFNGLGETPROGRAMINFOLOGPROC,       glGetProgramInfoLog) \
+    X(PFNGLUSEPROGRAMPROC,              glUseProgram) \
+    X(PFNGLGETUNIFORMLOCATIONPROC,      glGetUniformLocation) \
+    X(PFNGLUNIFORM1FPROC,               glUniform1f) \
+    X(PFNGLUNIFORM1IPROC,               glUniform1i) \
+    X(PFNGLUNIFORM3FPROC,               glUniform3f) \
+    X(PFNGLGENBUFFERSPROC,              glGenBuffers) \
+    X(PFNGLBINDBUFFERPROC,              glBindBuffer) \
+    X(PFNGLBUFFERDATAPROC,              glBufferData) \
+    X(PFNGLVERTEXATTRIBPOINTERPROC,     glVertexAttribPointer) \
+    X(PFNGLENABLEVERTEXATTRIBARRAYPROC, glEnableVertexAttribArray) \
+    X(PFNGLDISABLEVERTEXATTRIBARRAYPROC,glDisableVertexAttribArray)
+#define GPU_DECL(t,n) static t p##n;
+GPU_PROCS(GPU_DECL)
+
+enum { ATTR_POS0=0, ATTR_POS1=1, ATTR_UV=2 };
+static const char *gpuVertSrc=
+    "#version 120\n"
+    "attribute vec3 pos0;\n"
+    "attribute vec3 pos1;\n"
+    "attribute vec2 uv;\n"
+    "uniform float alpha;\n"
+    "uniform float scale;\n"
+    "uniform vec3 center;\n"
+    "varying vec2 tc;\n"
+    "void main(){\n"
+    "    vec3 p=mix(pos0,pos1,alpha)*scale-center;\n"
+    "    gl_Position=gl_ModelViewProjectionMatrix*vec4(p,1.0);\n"
+    "    tc=uv;\n"
+    "}\n";
+static const char *gpuFragSrc=
+    "#version 120\n"
+    "uniform sampler2D tex;\n"
+    "varying vec2 tc;\n"
+    "void main(){ gl_FragColor=texture2D(tex,tc); }\n";
+
+static int gpuAvailable=0, gpuBlend=0;
+static GLuint gpuProgram, gpuFrames, gpuUV, gpuIndex;
+static GLint uAlpha, uScale, uCenter, uTex;
+static size_t gpuCorners=0, gpuIndexCount=0, gpuFrameCount=0;
+
 static float bgColor[3] = {0.2f,0.2f,0.3f};
 static int initBgPaletteIndex=0, currentBgPaletteIndex=0;
 
@@ -62,8 +128,11 @@ static int lastMouseX, lastMouseY, leftButtonDown=0;
 static int wireframeMode=0, linearFiltering=0, spinning=1, overlayEnabled=1;
 static int winWidth=800, winHeight=600;
 
-static uint8_t* wavBuffers[7] = { NULL };
-static uint32_t wavBufferLens[7] = { 0 };
+static uint8_t* wavBuffers[8] = { NULL };
+static uint32_t wavBufferLens[8] = { 0 };
+
+// region holding file data, texture and WAV buffers
+static arena *modelMem = NULL;
 
 static int endswith(const char *s, const char *suffix) {
     size_t sl = strlen(s), su = strlen(suffix);
@@ -74,7 +143,7 @@ static void load_palette(const char *fn){
     FILE *f = fopen(fn,"rb"); if(!f){ perror(fn); exit(1); }
     fseek(f,0,SEEK_END); long sz = ftell(f);
     fseek(f,sz-768,SEEK_SET);
-    fread(palette,1,768,f);
+    fread(palette_rgb,1,768,f);
     fclose(f);
 }
 
@@ -82,22 +151,31 @@ void load_car_model(const char *fn) {
     FILE *f = fopen(fn,"rb");
     if (!f) { perror(fn); exit(1); }
     fseek(f,0,SEEK_END); rawSize=ftell(f); fseek(f,0,SEEK_SET);
-    rawData=malloc(rawSize); fread(rawData,1,rawSize,f); fclose(f);
 
-    vertexCount  = *(uint16_t*)(rawData+0x4866);
-    polygonCount = *(uint16_t*)(rawData+0x4868);
-    uint16_t texels = *(uint16_t*)(rawData+0x486A);
-    texWidth=TEX_WIDTH; texHeight=texels/TEX_WIDTH;
+    // size the region from the header: file + texture + WAV buffers
+    uint8_t head[sizeof(car_header)]={0};
+    fread(head,1,sizeof(head),f); rewind(f);
+    modelMem=csm_arena_create(csm_model_mem_size(head,rawSize)+csm_model_car_sfx_len((car_header*)head)+8*(44+CSM_ARENA_ALIGN));
+    rawData=modelMem?csm_arena_alloc(modelMem,rawSize):NULL;
+    if(!rawData || fread(rawData,1,rawSize,f)!=rawSize){ perror(fn); exit(1); }
+    fclose(f);
+
+    // section offsets of the whole file
+    layout=csm_car_layout_create(rawData,rawSize);
+    if(!layout.valid){ fprintf(stderr,"%s: not a .CAR model\n",fn); exit(1); }
 
-    size_t texOffset=0x486C;
-    uint8_t *indices=rawData+texOffset;
-    textureRGBA=malloc(texWidth*texHeight*4);
+    vertexCount  = ((car_header*)rawData)->vcount;
+    polygonCount = ((car_header*)rawData)->fcount;
+    texWidth=TEX_WIDTH; texHeight=layout.skin.len/TEX_WIDTH;
+
+    uint8_t *indices=rawData+layout.skin.off;
+    textureRGBA=csm_arena_alloc(modelMem,texWidth*texHeight*4);
     for(size_t i=0;i<texWidth*texHeight;i++){
         uint8_t idx=indices[i];
-        textureRGBA[4*i+0]=palette[idx][0];
-        textureRGBA[4*i+1]=palette[idx][1];
-        textureRGBA[4*i+2]=palette[idx][2];
-        textureRGBA[4*i+3]=(palette[idx][0]==4 && palette[idx][1]==4 && palette[idx][2]==4)?0:255;
+        textureRGBA[4*i+0]=palette_rgb[idx][0];
+        textureRGBA[4*i+1]=palette_rgb[idx][1];
+        textureRGBA[4*i+2]=palette_rgb[idx][2];
+        textureRGBA[4*i+3]=(palette_rgb[idx][0]==4 && palette_rgb[idx][1]==4 && palette_rgb[idx][2]==4)?0:255;
     }
     glGenTextures(1,&texID);
     glBindTexture(GL_TEXTURE_2D,texID);
@@ -105,39 +183,36 @@ void load_car_model(const char *fn) {
     glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
 
-    uint8_t *fd = rawData + texOffset + texels;
-    frameCount = (rawSize - (fd - rawData)) / (vertexCount*sizeof(Vertex));
-    animationFrames = (Vertex*)fd;
+    // main animations follow the skin back to back
+    size_t fd=layout.skin.off+layout.skin.len;
+    animationFrames = (Vertex*)(rawData+fd);
 
-    CARHeader *hdr=(CARHeader*)rawData;
-    size_t off=0; animCount=0;
+    frameCount=0; animCount=0;
     for(int i=0;i<20;i++){
-        uint16_t b=hdr->anims.model[i];
-        if(b){
-            size_t n=b/(vertexCount*sizeof(Vertex));
-            anims[animCount].start=off;
-            anims[animCount].count=n;
-            off+=n; animCount++;
+        if(layout.frame_count[i]){
+            anims[animCount].start=(layout.anims[i].off-fd)/(vertexCount*sizeof(Vertex));
+            anims[animCount].count=layout.frame_count[i];
+            frameCount+=layout.frame_count[i]; animCount++;
         }
     }
     if(!animCount){ anims[0].start=0; anims[0].count=frameCount; animCount=1; }
     currentAnim=0; animFrameIdx=0;
 
-    polygons=(CARPolygon*)(rawData+0x66);
+    polygons=(CARPolygon*)((car_header*)rawData)->faces;
 
     // choose background color
     int counts[256]={0};
     for(size_t i=0;i<texWidth*texHeight;i++){
         uint8_t idx=indices[i];
-        float b=(palette[idx][0]+palette[idx][1]+palette[idx][2])/(3.0f*255.0f);
+        float b=(palette_rgb[idx][0]+palette_rgb[idx][1]+palette_rgb[idx][2])/(3.0f*255.0f);
         if(b>0.2f) counts[idx]++;
     }
     int best=0,bc=0;
     for(int i=0;i<256;i++) if(counts[i]>bc){ bc=counts[i]; best=i; }
     initBgPaletteIndex=currentBgPaletteIndex=best;
-    bgColor[0]=palette[best][0]/255.0f;
-    bgColor[1]=palette[best][1]/255.0f;
-    bgColor[2]=palette[best][2]/255.0f;
+    bgColor[0]=palette_rgb[best][0]/255.0f;
+    bgColor[1]=palette_rgb[best][1]/255.0f;
+    bgColor[2]=palette_rgb[best][2]/255.0f;
 
     // center model
     float minX=1e9f,minY=1e9f,minZ=1e9f;
@@ -155,13 +230,11 @@ void load_car_model(const char *fn) {
     modelCenterZ=(minZ+maxZ)*0.5f;
 
     // build WAV buffers and apply volume factor
-    uint32_t totalBytes=0; for(int b=0;b<8;b++) totalBytes+=hdr->sfx.len[b];
-    long audio_off=rawSize-totalBytes, pos=audio_off;
     for(int b=0;b<8;b++){
-        uint16_t len=hdr->sfx.len[b];
+        size_t pos=layout.sfx[b].off, len=layout.sfx[b].len;
         if(len){
             uint32_t ws=44+len;
-            uint8_t *buf=malloc(ws);
+            uint8_t *buf=csm_arena_alloc(modelMem,ws);
             memcpy(buf+0,"RIFF",4);
             uint32_t chsz=36+len; memcpy(buf+4,&chsz,4);
             memcpy(buf+8,"WAVEfmt ",8);
@@ -173,7 +246,7 @@ void load_car_model(const char *fn) {
             uint16_t bps=8;      memcpy(buf+34,&bps,2);
             memcpy(buf+36,"data",4);
             uint32_t dlen=len;   memcpy(buf+40,&dlen,4);
-            for(int i=0;i<len;i++){
+            for(size_t i=0;i<len;i++){
                 uint8_t s = rawData[pos+i];
                 float centered = (float)s - 128.0f;
                 centered *= VOLUME_FACTOR;
@@ -184,8 +257,147 @@ void load_car_model(const char *fn) {
             wavBuffers[b]=buf;
             wavBufferLens[b]=ws;
         }
-        pos+=len;
     }
+    csm_arena_print(modelMem);
+}
+
+// mark vertices that move within each animation
+void classify_vertices(void){
+    for(int a=0;a<animCount;a++){
+        csm_anim_motion_reset(&animMotion[a]);
+        animMotion[a]=csm_anim_motion_create((const i16x3*)(animationFrames+anims[a].start*vertexCount),vertexCount,anims[a].count,NULL);
+        csm_anim_motion_print(&animMotion[a],a);
+    }
+}
+
+static inline void lerp_vertex(size_t vi,size_t f0,size_t f1,float alpha){
+    int16_t *pv0=animationFrames[f0*vertexCount+vi].xyz;
+    int16_t *pv1=animationFrames[f1*vertexCount+vi].xyz;
+    vertexCache[vi][0]=((1-alpha)*pv0[0]+alpha*pv1[0])*SCALE;
+    vertexCache[vi][1]=((1-alpha)*pv0[1]+alpha*pv1[1])*SCALE;
+    vertexCache[vi][2]=((1-alpha)*pv0[2]+alpha*pv1[2])*SCALE;
+}
+
+// refresh the cached frame, static vertices are only written on animation change
+void update_vertex_cache(size_t f0,size_t f1,float alpha){
+    if(!vertexCache) vertexCache=malloc(sizeof(float[3])*(vertexCount?vertexCount:1));
+    if(cacheAnim!=currentAnim){
+        for(size_t v=0;v<vertexCount;v++) lerp_vertex(v,f0,f1,alpha);
+    } else if(f0!=cacheF0 || f1!=cacheF1 || alpha!=cacheAlpha){
+        for(size_t i=0;i<animMotion[currentAnim].moving_count;i++) lerp_vertex(animMotion[currentAnim].moving[i],f0,f1,alpha);
+    }
+    cacheAnim=currentAnim; cacheF0=f0; cacheF1=f1; cacheAlpha=alpha;
+}
+
+static GLuint gpu_shader(GLenum type,const char *src){
+    GLuint sh=pglCreateShader(type); GLint ok=0;
+    pglShaderSource(sh,1,&src,NULL);
+    pglCompileShader(sh);
+    pglGetShaderiv(sh,GL_COMPILE_STATUS,&ok);
+    if(!ok){ char log[512]; pglGetShaderInfoLog(sh,sizeof(log),NULL,log); fprintf(stderr,"shader: %s\n",log); pglDeleteShader(sh); return 0; }
+    return sh;
+}
+
+// upload every animation frame once, returns 0 when shaders are unavailable
+int gpu_init(void){
+#define GPU_LOAD(t,n) if(!(p##n=(t)glutGetProcAddress(#n))) return 0;
+    GPU_PROCS(GPU_LOAD)
+#undef GPU_LOAD
+    GLuint vs=gpu_shader(GL_VERTEX_SHADER,gpuVertSrc), fs=gpu_shader(GL_FRAGMENT_SHADER,gpuFragSrc);
+    if(!vs || !fs){ pglDeleteShader(vs); pglDeleteShader(fs); return 0; }
+    gpuProgram=pglCreateProgram();
+    pglAttachShader(gpuProgram,vs); pglAttachShader(gpuProgram,fs);
+    pglBindAttribLocation(gpuProgram,ATTR_POS0,"pos0");
+    pglBindAttribLocation(gpuProgram,ATTR_POS1,"pos1");
+    pglBindAttribLocation(gpuProgram,ATTR_UV,"uv");
+    pglLinkProgram(gpuProgram);
+    // the shaders live on while attached to the program
+    pglDeleteShader(vs); pglDeleteShader(fs);
+    GLint ok=0; pglGetProgramiv(gpuProgram,GL_LINK_STATUS,&ok);
+    if(!ok){ char log[512]; pglGetProgramInfoLog(gpuProgram,sizeof(log),NULL,log); fprintf(stderr,"program: %s\n",log); pglDeleteProgram(gpuProgram); gpuProgram=0; return 0; }
+    uAlpha=pglGetUniformLocation(gpuProgram,"alpha");
+    uScale=pglGetUniformLocation(gpuProgram,"scale");
+    uCenter=pglGetUniformLocation(gpuProgram,"center");
+    uTex=pglGetUniformLocation(gpuProgram,"tex");
+
+    // unique (vertex,u,v) corners of all triangles, quads split as in display()
+    size_t maxCorners=polygonCount*6;
+    uint16_t *cornerVi=malloc(sizeof(uint16_t)*(maxCorners?maxCorners:1));
+    float (*cornerUV)[2]=malloc(sizeof(float[2])*(maxCorners?maxCorners:1));
+    uint16_t *index=malloc(sizeof(uint16_t)*(maxCorners?maxCorners:1));
+    if(!cornerVi || !cornerUV || !index){
+        free(index); free(cornerUV); free(cornerVi);
+        pglDeleteProgram(gpuProgram); gpuProgram=0;
+        return 0;
+    }
+    gpuCorners=0; gpuIndexCount=0;
+    for(size_t i=0;i<polygonCount;i++){
+        CARPolygon *p=&polygons[i];
+        int ord[6]={0,1,2,0,2,3}, n=p->vi[3]<(int)vertexCount?6:3;
+        for(int k=0;k<n;k++){
+            uint16_t vi=p->vi[ord[k]];
+            float u=p->uv[ord[k]][0]/(float)(texWidth<<8);
+            float v=(p->uv[ord[k]][1]+4*p->uv_offset)/(float)(texHeight<<8);
+            size_t c=0;
+            while(c<gpuCorners && !(cornerVi[c]==vi && cornerUV[c][0]==u && cornerUV[c][1]==v)) c++;
+            if(c==gpuCorners){ cornerVi[c]=vi; cornerUV[c][0]=u; cornerUV[c][1]=v; gpuCorners++; }
+            index[gpuIndexCount++]=(uint16_t)c;
+        }
+    }
+
+    // frames referenced by the animations, gathered per corner
+    size_t frames=anims[animCount-1].start+anims[animCount-1].count;
+    if(frames>frameCount) frames=frameCount;
+    Vertex *stream=malloc(sizeof(Vertex)*(frames*gpuCorners?frames*gpuCorners:1));
+    if(!stream){
+        free(index); free(cornerUV); free(cornerVi);
+        pglDeleteProgram(gpuProgram); gpuProgram=0;
+        return 0;
+    }
+    for(size_t f=0;f<frames;f++)
+        for(size_t c=0;c<gpuCorners;c++)
+            stream[f*gpuCorners+c]=animationFrames[f*vertexCount+cornerVi[c]];
+
+    pglGenBuffers(1,&gpuFrames); pglGenBuffers(1,&gpuUV); pglGenBuffers(1,&gpuIndex);
+    pglBindBuffer(GL_ARRAY_BUFFER,gpuFrames);
+    pglBufferData(GL_ARRAY_BUFFER,sizeof(Vertex)*frames*gpuCorners,stream,GL_STATIC_DRAW);
+    pglBindBuffer(GL_ARRAY_BUFFER,gpuUV);
+    pglBufferData(GL_ARRAY_BUFFER,sizeof(float[2])*gpuCorners,cornerUV,GL_STATIC_DRAW);
+    pglBindBuffer(GL_ARRAY_BUFFER,0);
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER,gpuIndex);
+    pglBufferData(GL_ELEMENT_ARRAY_BUFFER,sizeof(uint16_t)*gpuIndexCount,index,GL_STATIC_DRAW);
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
+    printf("gpu: corners=%zu frames=%zu uploaded=%zu B (floats: %zu B)\n",
+           gpuCorners,frames,sizeof(Vertex)*frames*gpuCorners,sizeof(float[3])*frames*gpuCorners);
+
+    free(stream); free(index); free(cornerUV); free(cornerVi);
+    gpuFrameCount=frames;
+    return 1;
+}
+
+// per tick only two attribute offsets and alpha change
+void draw_gpu(size_t f0,size_t f1,float alpha){
+    pglUseProgram(gpuProgram);
+    pglUniform1f(uAlpha,alpha);
+    pglUniform1f(uScale,32767.0f*SCALE);
+    pglUniform3f(uCenter,modelCenterX,modelCenterY,modelCenterZ);
+    pglUniform1i(uTex,0);
+    pglBindBuffer(GL_ARRAY_BUFFER,gpuFrames);
+    pglVertexAttribPointer(ATTR_POS0,3,GL_SHORT,GL_TRUE,0,(const void*)(f0*gpuCorners*sizeof(Vertex)));
+    pglVertexAttribPointer(ATTR_POS1,3,GL_SHORT,GL_TRUE,0,(const void*)(f1*gpuCorners*sizeof(Vertex)));
+    pglBindBuffer(GL_ARRAY_BUFFER,gpuUV);
+    pglVertexAttribPointer(ATTR_UV,2,GL_FLOAT,GL_FALSE,0,(const void*)0);
+    pglEnableVertexAttribArray(ATTR_POS0);
+    pglEnableVertexAttribArray(ATTR_POS1);
+    pglEnableVertexAttribArray(ATTR_UV);
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER,gpuIndex);
+    glDrawElements(GL_TRIANGLES,(GLsizei)gpuIndexCount,GL_UNSIGNED_SHORT,(const void*)0);
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
+    pglDisableVertexAttribArray(ATTR_POS0);
+    pglDisableVertexAttribArray(ATTR_POS1);
+    pglDisableVertexAttribArray(ATTR_UV);
+    pglBindBuffer(GL_ARRAY_BUFFER,0);
+    pglUseProgram(0);
 }
 
 void drawBitmapString(float x,float y,void*font,const char*s){
@@ -202,9 +414,10 @@ void drawOverlay(){
     const char* lines[]={
         "F1: Toggle Overlay","Space: Play/Pause","1-0: Select Anim","+/-: Cycle Anim",
         "R: Toggle Spin","ESC: Reset","W/S: Zoom","A/D: Rotate","TAB: Wireframe",
-        "F: Filter","Arrows: Pan","PgUp/Dn: Change BG","Mouse Drag: Rotate","F5-F11: Play Sound"
+        "F: Filter","Arrows: Pan","PgUp/Dn: Change BG","Mouse Drag: Rotate","F5-F11: Play Sound",
+        "G: GPU Blend"
     };
-    for(int i=0;i<14;i++){
+    for(int i=0;i<15;i++){
         drawBitmapString(10,winHeight-12*(i+1),GLUT_BITMAP_HELVETICA_10,lines[i]);
     }
     glEnable(GL_DEPTH_TEST);
@@ -258,50 +471,48 @@ void drawModelInfo(){
     glPopMatrix(); glMatrixMode(GL_PROJECTION); glPopMatrix(); glMatrixMode(GL_MODELVIEW);
 }
 
-void display(void){
-    glClearColor(bgColor[0],bgColor[1],bgColor[2],1.0f);
-    glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
-    glColor3f(1,1,1);
-    glLoadIdentity();
-    glTranslatef(translateX,translateY,-5.0f/zoom);
-    glTranslatef(modelCenterX,modelCenterY,modelCenterZ);
-    glRotatef(rotateY,0,1,0);
-    glRotatef(rotateX,1,0,0);
+// immediate mode from the CPU interpolated vertex cache
+void draw_cpu(size_t f0,size_t f1,float alpha){
     glTranslatef(-modelCenterX,-modelCenterY,-modelCenterZ);
 
-    float alpha=(animating && anims[currentAnim].count>1)?(animationTime/frameDuration):0.0f;
-    size_t f0=anims[currentAnim].start+animFrameIdx;
-    size_t f1=anims[currentAnim].start+((animFrameIdx+1)%anims[currentAnim].count);
+    update_vertex_cache(f0,f1,alpha);
 
-    glBindTexture(GL_TEXTURE_2D,texID);
     glBegin(GL_TRIANGLES);
     for(size_t i=0;i<polygonCount;i++){
         CARPolygon *p=&polygons[i];
         for(int v=0;v<3;v++){
-            int vi=p->vi[v];
-            int16_t *pv0=animationFrames[f0*vertexCount+vi].xyz;
-            int16_t *pv1=animationFrames[f1*vertexCount+vi].xyz;
-            float x=(1-alpha)*pv0[0]+alpha*pv1[0];
-            float y=(1-alpha)*pv0[1]+alpha*pv1[1];
-            float z=(1-alpha)*pv0[2]+alpha*pv1[2];
             glTexCoord2f(p->uv[v][0]/(float)(texWidth<<8),(p->uv[v][1]+4*p->uv_offset)/(float)(texHeight<<8));
-            glVertex3f(x*SCALE,y*SCALE,z*SCALE);
+            glVertex3fv(vertexCache[p->vi[v]]);
         }
         if(p->vi[3]<(int)vertexCount){
             int ord[3]={0,2,3};
             for(int v=0;v<3;v++){
-                int vi=p->vi[ord[v]];
-                int16_t *pv0=animationFrames[f0*vertexCount+vi].xyz;
-                int16_t *pv1=animationFrames[f1*vertexCount+vi].xyz;
-                float x=(1-alpha)*pv0[0]+alpha*pv1[0];
-                float y=(1-alpha)*pv0[1]+alpha*pv1[1];
-                float z=(1-alpha)*pv0[2]+alpha*pv1[2];
                 glTexCoord2f(p->uv[ord[v]][0]/(float)(texWidth<<8),(p->uv[ord[v]][1]+4*p->uv_offset)/(float)(texHeight<<8));
-                glVertex3f(x*SCALE,y*SCALE,z*SCALE);
+                glVertex3fv(vertexCache[p->vi[ord[v]]]);
             }
         }
     }
     glEnd();
+}
+
+void display(void){
+    glClearColor(bgColor[0],bgColor[1],bgColor[2],1.0f);
+    glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+    glColor3f(1,1,1);
+    glLoadIdentity();
+    glTranslatef(translateX,translateY,-5.0f/zoom);
+    glTranslatef(modelCenterX,modelCenterY,modelCenterZ);
+    glRotatef(rotateY,0,1,0);
+    glRotatef(rotateX,1,0,0);
+
+    float alpha=(animating && anims[currentAnim].count>1)?(animationTime/frameDuration):0.0f;
+    size_t f0=anims[currentAnim].start+animFrameIdx;
+    size_t f1=anims[currentAnim].start+((animFrameIdx+1)%anims[currentAnim].count);
+
+    glBindTexture(GL_TEXTURE_2D,texID);
+    // frames past the uploaded ones are only reachable on the CPU path
+    if(gpuBlend && f0<gpuFrameCount && f1<gpuFrameCount) draw_gpu(f0,f1,alpha);
+    else                                                 draw_cpu(f0,f1,alpha);
 
     if(overlayEnabled){
        // drawOverlay();
@@ -363,9 +574,9 @@ void special(int key,int x,int y){
       case GLUT_KEY_F11: if(wavBuffers[6]) PlaySound((LPCSTR)wavBuffers[6], NULL, SND_MEMORY|SND_ASYNC); break;
 */
     }
-    bgColor[0]=palette[currentBgPaletteIndex][0]/255.0f;
-    bgColor[1]=palette[currentBgPaletteIndex][1]/255.0f;
-    bgColor[2]=palette[currentBgPaletteIndex][2]/255.0f;
+    bgColor[0]=palette_rgb[currentBgPaletteIndex][0]/255.0f;
+    bgColor[1]=palette_rgb[currentBgPaletteIndex][1]/255.0f;
+    bgColor[2]=palette_rgb[currentBgPaletteIndex][2]/255.0f;
 }
 
 void keyboard(unsigned char k,int x,int y){
@@ -376,15 +587,16 @@ void keyboard(unsigned char k,int x,int y){
         translateX=initTranslateX; translateY=initTranslateY;
         zoom=initZoom; spinning=1;
         currentBgPaletteIndex=initBgPaletteIndex;
-        bgColor[0]=palette[initBgPaletteIndex][0]/255.0f;
-        bgColor[1]=palette[initBgPaletteIndex][1]/255.0f;
-        bgColor[2]=palette[initBgPaletteIndex][2]/255.0f;
+        bgColor[0]=palette_rgb[initBgPaletteIndex][0]/255.0f;
+        bgColor[1]=palette_rgb[initBgPaletteIndex][1]/255.0f;
+        bgColor[2]=palette_rgb[initBgPaletteIndex][2]/255.0f;
         break;
       case 'w': zoom*=1.1f; break;
       case 's': zoom/=1.1f; break;
       case 'a': rotateY-=10; break;
       case 'd': rotateY+=10; break;
       case 'r': spinning=!spinning; break;
+      case 'g': case 'G': gpuBlend=gpuAvailable && !gpuBlend; break;
       case ' ': animating=!animating; break;
       case '\t':
         wireframeMode=!wireframeMode;
@@ -438,6 +650,9 @@ int main(int argc,char**argv){
 
     load_palette("assets/chasmpalette.act");
     load_car_model(argv[1]);
+    classify_vertices();
+    gpuAvailable=gpu_init();
+    if(!gpuAvailable) fprintf(stderr,"GPU blending unavailable, using CPU interpolation\n");
 
     glutMouseFunc(mouse);
     glutMotionFunc(motion);
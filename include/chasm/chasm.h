@@ -1,6 +1,16 @@
 #pragma once
 
 #ifdef __cplusplus
+#include <atomic>
+#include <cmath>
+/* C11 atomics of the animation pool */
+#define CSM_ATOMIC(T) std::atomic<T>
+using std::atomic_load_explicit;
+using std::atomic_store_explicit;
+using std::atomic_exchange_explicit;
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_acq_rel;
 extern "C" {
 #include <cstdint>
 #include <cstddef>
@@ -13,8 +23,21 @@ extern "C" {
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <math.h>
+#define CSM_ATOMIC(T) _Atomic T
 #endif
 #include <sys/stat.h>
+#include <pthread.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #include <GL/gl.h>
 #include <GL/glcorearb.h>
 
@@ -106,6 +129,35 @@ typedef struct anim_info
 	size_t start;
 	size_t count;
 } anim_info;
+
+typedef struct arena_block
+{
+	struct arena_block* next;
+	size_t               cap;
+	size_t              used;
+	u8                 mem[];
+} arena_block;
+
+/* region allocator, everything is released at once */
+typedef struct arena
+{
+	arena_block* head;
+	size_t      block;
+	size_t     blocks;
+	size_t       used;
+	size_t       peak;
+	size_t      total;
+} arena;
+
+typedef struct anim_motion
+{
+	/* indices of vertices that move anywhere within the animation, not per frame range */
+	u16*         moving;
+	size_t moving_count;
+	size_t       vcount;
+	size_t       frames;
+	arena*          mem;
+} anim_motion;
 /*
 typedef struct ani_file
 {
@@ -120,6 +172,36 @@ typedef struct ani_file
 } ani_file;
 
 */
+/* byte range inside the file */
+typedef struct span
+{
+	size_t off;
+	size_t len;
+} span;
+
+/* embedded sub-model: 3O header followed by two animation spans */
+typedef struct car_sub_model
+{
+	c3o_header*        hdr;
+	size_t             off;
+	span         frames[2];
+	size_t frame_count[2];
+} car_sub_model;
+
+/* offsets of every section of a .CAR file, computed once */
+typedef struct car_layout
+{
+	span               skin;
+	span          anims[20];
+	size_t frame_count[20];
+	car_sub_model    sub[6];
+	size_t        sub_count;
+	span            sfx[8];
+	/* bytes covered by all sections */
+	size_t              end;
+	bool              valid;
+} car_layout;
+
 typedef struct model
 {
 	/* raw file data */
@@ -130,6 +212,9 @@ typedef struct model
 	/* pointer to post header suffix tail */
 	u8*             tdata;
 	i16x3*    anim_frames;
+	/* raw .ANI data of a .3O model */
+	u8*          ani_data;
+	size_t        ani_len;
 	/* content description */
 	size_t    frame_count;
 	size_t    total_frames;
@@ -145,6 +230,13 @@ typedef struct model
 	size_t     anim_count;
 	size_t   anim_current;
 	size_t anim_frame_idx;
+	anim_motion motion[20];
+	/* region holding data, trgba, ani_data and motion, owned unless caller supplied */
+	arena*            mem;
+	bool        mem_owned;
+	/* sub-model sharing data and trgba of its parent */
+	bool             view;
+	car_layout     layout;
 } model;
 
 typedef struct config
@@ -163,6 +255,128 @@ typedef struct config
 
 config settings;
 #pragma pack(pop)
+
+/* vertex positions and triangle normals of one animation tick, normal face * 2 + half as in bvh */
+typedef struct anim_output
+{
+	f32*       pos;
+	f32*       nrm;
+	size_t    anim;
+	size_t    tick;
+} anim_output;
+
+#define CSM_ANIM_FRESH 4u
+#define CSM_ANIM_NONE  SIZE_MAX
+
+/* triple buffered animation state of one model instance */
+typedef struct anim_instance
+{
+	model*           mdl;
+	/* animation of the render thread, written only under the pool lock by csm_anim_pool_play */
+	size_t          anim;
+	/* animation the worker evaluates, copied from anim under the pool lock */
+	size_t     work_anim;
+	anim_output   out[3];
+	/* slot handed over to the render thread, CSM_ANIM_FRESH when unread */
+	CSM_ATOMIC(u32) ready;
+	/* slot owned by the worker */
+	u32            write;
+	/* slot owned by the render thread */
+	u32             read;
+} anim_instance;
+
+typedef struct anim_pool
+{
+	pthread_t*       threads;
+	size_t           workers;
+	anim_instance* instances;
+	size_t             count;
+	size_t   ticks_per_frame;
+	pthread_mutex_t     lock;
+	pthread_cond_t      wake;
+	size_t            target;
+	size_t        generation;
+	bool                stop;
+} anim_pool;
+
+/* bounding volume hierarchy over the triangles of a frame */
+#define CSM_BVH_LEAF 4
+
+typedef struct bvh_node
+{
+	f32    min[3];
+	f32    max[3];
+	/* first child (children are adjacent) or first triangle of a leaf */
+	u32     first;
+	/* triangles of a leaf, 0 for inner nodes */
+	u32     count;
+} bvh_node;
+
+typedef struct bvh
+{
+	bvh_node*   nodes;
+	size_t node_count;
+	/* triangle ids: face * 2 + half, half 1 is the second triangle of a quad */
+	u32*         tris;
+	size_t  tri_count;
+	const face* faces;
+	size_t     vcount;
+} bvh;
+
+typedef struct bvh_hit
+{
+	bool   hit;
+	size_t face;
+	u8     half;
+	/* ray parameter or distance to the point */
+	f32    t;
+	f32    u, v;
+} bvh_hit;
+
+/* resource archive (CSM.BIN): "CSid", u16 count, count * { u8 len; char name[12]; u32 size; u32 offset; } */
+#define CSM_ARCHIVE_MAGIC "CSid"
+#define CSM_ARCHIVE_NAME  12
+
+typedef struct archive_entry
+{
+	char name[CSM_ARCHIVE_NAME + 1];
+	size_t                      len;
+	size_t                      off;
+} archive_entry;
+
+typedef struct archive
+{
+	/* mapped archive file */
+	u8*                data;
+	size_t              len;
+	bool             mapped;
+	archive_entry*  entries;
+	size_t            count;
+	/* open addressed name hash, entry index + 1, 0 is empty */
+	u32*              index;
+	size_t            slots;
+} archive;
+
+/* 18 bit RGB666 inverse palette */
+#define CSM_QUANT_BITS 18
+
+enum dither
+{
+	CSM_DITHER_NONE    = 0,
+	CSM_DITHER_ORDERED = 1,
+	CSM_DITHER_FLOYD   = 2,
+};
+
+typedef struct quantizer
+{
+	/* nearest opaque index per RGB666 key, padded for 32 bit gathers */
+	u8   lut[(1 << CSM_QUANT_BITS) + 4];
+	palette*                       pal;
+	/* index written for alpha < 128, never produced by the lut */
+	u8                     transparent;
+	/* mean distance between opaque palette colours and their nearest neighbour */
+	u8                          spread;
+} quantizer;
 /*
 ani_file* csm_model_ani_update(model* model, size_t i)
 {
@@ -201,11 +415,122 @@ size_t acc(u16* src, size_t cnt, size_t init)
 	return init;
 }
 
-u8x4* tpal2rgba(u8* buf, size_t len, palette* pal)
+#define CSM_ARENA_ALIGN 16
+
+size_t csm_arena_align(size_t len)
+{
+	return (len + CSM_ARENA_ALIGN - 1) & ~(size_t)(CSM_ARENA_ALIGN - 1);
+}
+
+arena_block* csm_arena_block_create(size_t cap)
+{
+	arena_block* dst = (arena_block*)malloc(sizeof(arena_block) + cap + CSM_ARENA_ALIGN);
+	if(dst == NULL) return NULL;
+	dst->next = NULL;
+	dst->cap  = cap + CSM_ARENA_ALIGN;
+	dst->used = 0;
+	return dst;
+}
+
+/* arena with a first block of cap bytes, further blocks are at least cap bytes */
+arena* csm_arena_create(size_t cap)
+{
+	arena* dst = (arena*)calloc(sizeof(arena), 1);
+	if(dst == NULL) return NULL;
+	dst->block  = cap > 0 ? cap : 4096;
+	dst->head   = csm_arena_block_create(dst->block);
+	dst->blocks = dst->head ? 1 : 0;
+	return dst;
+}
+
+/* uninitialised, CSM_ARENA_ALIGN aligned allocation */
+void* csm_arena_alloc(arena* mem, size_t len)
+{
+	if(mem == NULL || len == 0) return NULL;
+
+	arena_block* blk = mem->head;
+	uintptr_t    pos = blk ? csm_arena_align((uintptr_t)(blk->mem + blk->used)) : 0;
+	if(blk == NULL || pos + len > (uintptr_t)(blk->mem + blk->cap))
+	{
+		blk = csm_arena_block_create(len > mem->block ? len : mem->block);
+		if(blk == NULL) return NULL;
+		blk->next = mem->head;
+		mem->head = blk;
+		mem->blocks++;
+		pos = csm_arena_align((uintptr_t)blk->mem);
+	}
+	blk->used    = pos + len - (uintptr_t)blk->mem;
+	mem->used   += len;
+	mem->total  += len;
+	mem->peak    = mem->used > mem->peak ? mem->used : mem->peak;
+	return (void*)pos;
+}
+
+/* release all allocations, a grown arena is coalesced into one block that fits the last round */
+arena* csm_arena_reset(arena* mem)
+{
+	if(mem != NULL && mem->head != NULL)
+	{
+		if(mem->head->next != NULL)
+		{
+			size_t       cap = 0;
+			arena_block* blk = mem->head;
+			while(blk != NULL)
+			{
+				arena_block* next = blk->next;
+				cap += blk->cap;
+				free(blk);
+				blk = next;
+			}
+			mem->head   = csm_arena_block_create(cap);
+			mem->blocks = mem->head ? 1 : 0;
+		}
+		if(mem->head != NULL)
+			mem->head->used = 0;
+		mem->used = 0;
+	}
+	return mem;
+}
+
+arena* csm_arena_delete(arena* mem)
+{
+	if(mem != NULL)
+	{
+		arena_block* blk = mem->head;
+		while(blk != NULL)
+		{
+			arena_block* next = blk->next;
+			free(blk);
+			blk = next;
+		}
+		free(mem);
+		mem = NULL;
+	}
+	return mem;
+}
+
+void csm_arena_print(const arena* mem)
+{
+	if(mem != NULL)
+		printf("[NFO][MEM] blocks: %zu used: %zu peak: %zu total: %zu\n", mem->blocks, mem->used, mem->peak, mem->total);
+}
+
+/* allocate from mem, or zeroed from the heap when mem is NULL */
+void* csm_alloc(arena* mem, size_t len)
+{
+	return mem ? csm_arena_alloc(mem, len) : calloc(len, 1);
+}
+
+void csm_free(arena* mem, void* ptr)
+{
+	if(mem == NULL) free(ptr);
+}
+
+u8x4* tpal2rgba(u8* buf, size_t len, palette* pal, arena* mem)
 {
 	if(buf == NULL || pal == NULL || len <= 0) return NULL;
 
-	u8x4* dst = (u8x4*)calloc(sizeof(u8x4), len);
+	u8x4* dst = (u8x4*)csm_alloc(mem, sizeof(u8x4) * len);
 	for(size_t i = 0; i < len; i++)
 	{
 		const size_t
@@ -239,6 +564,17 @@ palette* csm_palette_create_fn(const char* filename)
 	return dst;
 }
 
+/* palette from the first 768 bytes of buf */
+palette* csm_palette_create(const u8* buf, size_t len)
+{
+	if(buf == NULL || len < sizeof(palette)) return NULL;
+
+	palette* dst = (palette*)calloc(sizeof(palette), 1);
+	if(dst != NULL)
+		memcpy(dst, buf, sizeof(palette));
+	return dst;
+}
+
 palette* csm_palette_delete(palette* pal)
 {
 	if(pal != NULL)
@@ -249,7 +585,277 @@ palette* csm_palette_delete(palette* pal)
 	return pal;
 }
 
+/* palette entries of colour 4,4,4 are transparent, see tpal2rgba */
+bool csm_palette_transparent(const palette* pal, size_t idx)
+{
+	return (*pal)[idx].r == 4 && (*pal)[idx].g == 4 && (*pal)[idx].b == 4;
+}
+
+/* index a skin of fmt is drawn transparent with: index 4 in .3O, the 4,4,4 colour in .CAR */
+u8 csm_palette_transparent_index(const palette* pal, enum format fmt)
+{
+	for(size_t i = 0; fmt == CHASM_FORMAT_CAR && i < 256; i++)
+		if(csm_palette_transparent(pal, i)) return (u8)i;
+	return 4;
+}
+
+/* brute force nearest palette index other than transparent */
+u8 csm_palette_nearest(const palette* pal, u8 transparent, i32 r, i32 g, i32 b)
+{
+	u32 best = UINT32_MAX;
+	u8  dst  = 0;
+	for(size_t i = 0; i < 256; i++)
+	{
+		if(i == transparent) continue;
+		const i32 dr = r - (*pal)[i].r, dg = g - (*pal)[i].g, db = b - (*pal)[i].b;
+		const u32 d  = (u32)(dr * dr + dg * dg + db * db);
+		if(d < best) { best = d; dst = (u8)i; }
+	}
+	return dst;
+}
+
+static inline u32 csm_quant_key(i32 r, i32 g, i32 b)
+{
+	r = r < 0 ? 0 : (r > 255 ? 255 : r);
+	g = g < 0 ? 0 : (g > 255 ? 255 : g);
+	b = b < 0 ? 0 : (b > 255 ? 255 : b);
+	return (u32)(r >> 2) | (u32)(g >> 2) << 6 | (u32)(b >> 2) << 12;
+}
+
+/* entries of src that can be nearest to some point of the box lo..lo + ext, the rest are
+   farther from the box than the smallest farthest-corner distance, index order is kept */
+size_t csm_quant_candidates(const palette* pal, const u8* src, size_t len, const i32 lo[3], i32 ext, u8* dst)
+{
+	u32 dmin[256];
+	u32 bound = UINT32_MAX;
+	for(size_t i = 0; i < len; i++)
+	{
+		const u8x3 c = (*pal)[src[i]];
+		const i32 r0 = c.r - lo[0], r1 = lo[0] + ext - c.r;
+		const i32 g0 = c.g - lo[1], g1 = lo[1] + ext - c.g;
+		const i32 b0 = c.b - lo[2], b1 = lo[2] + ext - c.b;
+		const i32 rx = r0 > r1 ? r0 : r1, gx = g0 > g1 ? g0 : g1, bx = b0 > b1 ? b0 : b1;
+		const i32 rn = r0 < 0 ? r0 : (r1 < 0 ? r1 : 0), gn = g0 < 0 ? g0 : (g1 < 0 ? g1 : 0), bn = b0 < 0 ? b0 : (b1 < 0 ? b1 : 0);
+		const u32 dmax = (u32)(rx * rx + gx * gx + bx * bx);
+		dmin[i] = (u32)(rn * rn + gn * gn + bn * bn);
+		bound   = dmax < bound ? dmax : bound;
+	}
+
+	size_t n = 0;
+	for(size_t i = 0; i < len; i++)
+		if(dmin[i] <= bound) dst[n++] = src[i];
+	return n;
+}
+
+/* fill the cube of cells RGB666 cells at centre lo with the nearest of src, the candidates
+   narrow as the cube is split in eight, ties resolve to the lowest index like csm_palette_nearest */
+void csm_quant_fill(quantizer* q, const u8* src, size_t len, const i32 lo[3], i32 cells)
+{
+	u8           cand[256];
+	const size_t n = csm_quant_candidates(q->pal, src, len, lo, (cells - 1) * 4, cand);
+
+	if(n == 1)
+	{
+		for(i32 z = 0; z < cells; z++)
+			for(i32 y = 0; y < cells; y++)
+				for(i32 x = 0; x < cells; x++)
+					q->lut[csm_quant_key(lo[0] + x * 4, lo[1] + y * 4, lo[2] + z * 4)] = cand[0];
+		return;
+	}
+
+	if(cells > 2)
+	{
+		const i32 half = cells / 2;
+		for(i32 c = 0; c < 8; c++)
+		{
+			const i32 sub[3] = { lo[0] + (c & 1) * half * 4, lo[1] + ((c >> 1) & 1) * half * 4, lo[2] + (c >> 2) * half * 4 };
+			csm_quant_fill(q, cand, n, sub, half);
+		}
+		return;
+	}
+
+	/* last 2x2x2 cells, one candidate at a time against all eight */
+	u32 best[8];
+	u8  idx[8];
+	for(i32 c = 0; c < 8; c++)
+	{
+		best[c] = UINT32_MAX;
+		idx[c]  = cand[0];
+	}
+	for(size_t i = 0; i < n; i++)
+	{
+		const u8x3 p = (*q->pal)[cand[i]];
+		for(i32 c = 0; c < 8; c++)
+		{
+			const i32 dr = lo[0] + (c & 1) * 4 - p.r, dg = lo[1] + ((c >> 1) & 1) * 4 - p.g, db = lo[2] + (c >> 2) * 4 - p.b;
+			const u32 d  = (u32)(dr * dr + dg * dg + db * db);
+			idx[c]  = d < best[c] ? cand[i] : idx[c];
+			best[c] = d < best[c] ? d : best[c];
+		}
+	}
+	for(i32 c = 0; c < 8; c++)
+		q->lut[csm_quant_key(lo[0] + (c & 1) * 4, lo[1] + ((c >> 1) & 1) * 4, lo[2] + (c >> 2) * 4)] = idx[c];
+}
+
+/* inverse palette skipping the transparent index, see csm_palette_transparent_index */
+quantizer* csm_quantizer_create(palette* pal, u8 transparent)
+{
+	if(pal == NULL) return NULL;
+
+	quantizer* dst = (quantizer*)calloc(sizeof(quantizer), 1);
+	if(dst == NULL) return NULL;
+	dst->pal         = pal;
+	dst->transparent = transparent;
+
+	/* nearest colour to the centre of every RGB666 cell, later duplicates of a colour never win */
+	u8     all[256];
+	size_t count = 0;
+	for(size_t i = 0; i < 256; i++)
+	{
+		size_t j = 0;
+		while(j < count && memcmp(&(*pal)[all[j]], &(*pal)[i], sizeof(u8x3)) != 0) j++;
+		if(i != transparent && j == count) all[count++] = (u8)i;
+	}
+	const i32 lo[3] = { 2, 2, 2 };
+	csm_quant_fill(dst, all, count, lo, 1 << (CSM_QUANT_BITS / 3));
+
+	/* exact palette colours map back to their lowest index */
+	for(size_t i = 256; i-- > 0;)
+		if(i != transparent)
+			dst->lut[csm_quant_key((*pal)[i].r, (*pal)[i].g, (*pal)[i].b)] = (u8)i;
 
+	/* ordered dither amplitude, duplicate colours are skipped */
+	f32    sum = 0;
+	size_t n   = 0;
+	for(size_t i = 0; i < 256; i++)
+	{
+		if(i == transparent) continue;
+		u32 best = UINT32_MAX;
+		for(size_t j = 0; j < 256; j++)
+		{
+			if(j == transparent) continue;
+			const i32 dr = (*pal)[i].r - (*pal)[j].r, dg = (*pal)[i].g - (*pal)[j].g, db = (*pal)[i].b - (*pal)[j].b;
+			const u32 d  = (u32)(dr * dr + dg * dg + db * db);
+			if(d > 0 && d < best) best = d;
+		}
+		if(best == UINT32_MAX) continue;
+		sum += sqrtf((f32)best);
+		n++;
+	}
+	dst->spread = n ? (u8)(sum / n + 0.5f) : 16;
+	return dst;
+}
+
+quantizer* csm_quantizer_delete(quantizer* q)
+{
+	if(q != NULL)
+	{
+		free(q);
+		q = NULL;
+	}
+	return q;
+}
+
+/* undithered rows, keys of 8 (AVX2) or 4 (SSE2) pixels at a time */
+size_t csm_quantize_plain(const quantizer* q, const u8x4* src, size_t len, u8* dst)
+{
+	size_t i = 0;
+#if defined(__AVX2__)
+	const __m256i m_r = _mm256_set1_epi32(0x0003f), m_g = _mm256_set1_epi32(0x00fc0), m_b = _mm256_set1_epi32(0x3f000);
+	const __m256i m_i = _mm256_set1_epi32(0xff),   t   = _mm256_set1_epi32(q->transparent);
+	for(; i + 8 <= len; i += 8)
+	{
+		const __m256i p   = _mm256_loadu_si256((const __m256i*)(src + i));
+		const __m256i key = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(p, 2), m_r),
+		                    _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(p, 4), m_g),
+		                                    _mm256_and_si256(_mm256_srli_epi32(p, 6), m_b)));
+		__m256i idx = _mm256_and_si256(_mm256_i32gather_epi32((const int*)q->lut, key, 1), m_i);
+		/* alpha < 128 selects the transparent index */
+		idx = _mm256_blendv_epi8(t, idx, _mm256_srai_epi32(p, 31));
+		const __m128i w = _mm_packus_epi32(_mm256_castsi256_si128(idx), _mm256_extracti128_si256(idx, 1));
+		_mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(w, w));
+	}
+#elif defined(__SSE2__)
+	const __m128i m_r = _mm_set1_epi32(0x0003f), m_g = _mm_set1_epi32(0x00fc0), m_b = _mm_set1_epi32(0x3f000);
+	for(; i + 4 <= len; i += 4)
+	{
+		const __m128i p   = _mm_loadu_si128((const __m128i*)(src + i));
+		const __m128i key = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 2), m_r),
+		                    _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 4), m_g),
+		                                 _mm_and_si128(_mm_srli_epi32(p, 6), m_b)));
+		u32 k[4];
+		_mm_storeu_si128((__m128i*)k, key);
+		for(size_t j = 0; j < 4; j++)
+			dst[i + j] = src[i + j].a < 128 ? q->transparent : q->lut[k[j]];
+	}
+#endif
+	for(; i < len; i++)
+		dst[i] = src[i].a < 128 ? q->transparent : q->lut[csm_quant_key(src[i].r, src[i].g, src[i].b)];
+	return len;
+}
+
+/* map w * h RGBA pixels to palette indices, returns the pixel count */
+size_t csm_quantize(const quantizer* q, const u8x4* src, size_t w, size_t h, u8* dst, enum dither mode)
+{
+	static const i8 bayer[4][4] = { { 0, 8, 2, 10 }, { 12, 4, 14, 6 }, { 3, 11, 1, 9 }, { 15, 7, 13, 5 } };
+
+	if(q == NULL || src == NULL || dst == NULL) return 0;
+
+	switch(mode)
+	{
+		case CSM_DITHER_NONE:
+			return csm_quantize_plain(q, src, w * h, dst);
+		case CSM_DITHER_ORDERED:
+		{
+			/* symmetric bayer offset of +-spread / 2 around the pixel */
+			for(size_t y = 0; y < h; y++)
+				for(size_t x = 0; x < w; x++)
+				{
+					const u8x4* p = &src[y * w + x];
+					const i32   d = (2 * bayer[y & 3][x & 3] - 15) * q->spread / 32;
+					dst[y * w + x] = p->a < 128 ? q->transparent : q->lut[csm_quant_key(p->r + d, p->g + d, p->b + d)];
+				}
+			return w * h;
+		}
+		case CSM_DITHER_FLOYD:
+		{
+			/* error of the current and next row, one pixel of padding each side */
+			i32* err = (i32*)calloc(sizeof(i32) * 3, (w + 2) * 2);
+			if(err == NULL) return 0;
+			for(size_t y = 0; y < h; y++)
+			{
+				i32* cur = err + ((y & 1) ? (w + 2) * 3 : 0);
+				i32* nxt = err + ((y & 1) ? 0 : (w + 2) * 3);
+				memset(nxt, 0, sizeof(i32) * 3 * (w + 2));
+				for(size_t x = 0; x < w; x++)
+				{
+					const u8x4* p = &src[y * w + x];
+					i32*        e = cur + (x + 1) * 3;
+					if(p->a < 128) { dst[y * w + x] = q->transparent; continue; }
+
+					const i32 c[3] = { p->r + e[0] / 16, p->g + e[1] / 16, p->b + e[2] / 16 };
+					const u8  idx  = q->lut[csm_quant_key(c[0], c[1], c[2])];
+					dst[y * w + x] = idx;
+					for(size_t k = 0; k < 3; k++)
+					{
+						const i32 v = c[k] < 0 ? 0 : (c[k] > 255 ? 255 : c[k]);
+						const i32 d = v - (*q->pal)[idx].rgb[k];
+						e[3 + k]                 += d * 7;
+						nxt[(x + 0) * 3 + k]     += d * 3;
+						nxt[(x + 1) * 3 + k]     += d * 5;
+						nxt[(x + 2) * 3 + k]     += d * 1;
+					}
+				}
+			}
+			free(err);
+			return w * h;
+		}
+	}
+	return 0;
+}
+
+
+/* bytes of all animation data: main frames plus sub-model headers and frames */
 size_t csm_model_car_frame_count(car_header* hdr)
 {
 	size_t dst = acc(hdr->anims.model, 20, 0);
@@ -257,7 +863,7 @@ size_t csm_model_car_frame_count(car_header* hdr)
 	for(size_t i = 0; i < 6; i++)
 	{
 		const size_t sum = acc(hdr->anims.sub_model[i], 2, 0);
-		dst += sum == 0 ? 0 : dst + sizeof(c3o_header);
+		dst += sum == 0 ? 0 : sum + sizeof(c3o_header);
 	}
 	return dst;
 }
@@ -267,33 +873,192 @@ size_t csm_model_car_sfx_len(car_header* hdr)
 	return acc(hdr->sfx.len, 8, 0);
 }
 
+/* walk header, skin, animations, sub-models and sfx of a .CAR buffer */
+car_layout csm_car_layout_create(const u8* buf, size_t len)
+{
+	car_layout dst = {0};
+	if(buf == NULL || len < sizeof(car_header)) return dst;
+
+	const car_header* car  = (const car_header*)buf;
+	const size_t    stride = car->vcount * sizeof(i16x3);
+	size_t             off = sizeof(car_header);
+
+	dst.skin = (span){ off, car->th };
+	off     += car->th;
+
+	for(size_t i = 0; i < 20; i++)
+	{
+		dst.anims[i]       = (span){ off, car->anims.model[i] };
+		dst.frame_count[i] = stride ? car->anims.model[i] / stride : 0;
+		off               += car->anims.model[i];
+	}
+
+	for(size_t i = 0; i < 6; i++)
+	{
+		car_sub_model* sub = &dst.sub[i];
+		const size_t   sum = acc((u16*)car->anims.sub_model[i], 2, 0);
+		if(sum == 0) continue;
+		if(off + sizeof(c3o_header) > len) return dst;
+
+		sub->off     = off;
+		sub->hdr     = (c3o_header*)(buf + off);
+		off         += sizeof(c3o_header);
+		for(size_t k = 0; k < 2; k++)
+		{
+			const size_t sub_stride = sub->hdr->vcount * sizeof(i16x3);
+			sub->frames[k]      = (span){ off, car->anims.sub_model[i][k] };
+			sub->frame_count[k] = sub_stride ? car->anims.sub_model[i][k] / sub_stride : 0;
+			off                += car->anims.sub_model[i][k];
+		}
+		dst.sub_count++;
+	}
+
+	for(size_t i = 0; i < 8; i++)
+	{
+		dst.sfx[i] = (span){ off, car->sfx.len[i] };
+		off       += car->sfx.len[i];
+	}
+	dst.end   = off;
+	dst.valid = off == len;
+	return dst;
+}
+
+void csm_car_layout_print(const car_layout* src)
+{
+	printf("[NFO][CAR] skin: %zu+%zu end: %zu valid: %d\n", src->skin.off, src->skin.len, src->end, src->valid);
+	for(size_t i = 0; i < 20; i++)
+		if(src->anims[i].len)
+			printf("[NFO][CAR] anim %2zu: %zu+%zu frames: %zu\n", i, src->anims[i].off, src->anims[i].len, src->frame_count[i]);
+	for(size_t i = 0; i < 6; i++)
+		if(src->sub[i].hdr)
+			printf("[NFO][CAR] sub  %2zu: %zu vcount: %u fcount: %u frames: %zu,%zu\n", i, src->sub[i].off,
+			       src->sub[i].hdr->vcount, src->sub[i].hdr->fcount, src->sub[i].frame_count[0], src->sub[i].frame_count[1]);
+	for(size_t i = 0; i < 8; i++)
+		if(src->sfx[i].len)
+			printf("[NFO][CAR] sfx  %2zu: %zu+%zu\n", i, src->sfx[i].off, src->sfx[i].len);
+}
+
 size_t csm_model_car_anim_count(model* hdr)
 {
-	hdr->frame_count = csm_model_car_frame_count(hdr->car);
+	hdr->layout      = csm_car_layout_create(hdr->data, hdr->len);
+	hdr->frame_count = 0;
 	size_t off = 0;
 	for(size_t i = 0; i < 20; i++)
 	{
-		uint16_t b = hdr->car->anims.model[i];
-		if(b)
+		size_t n = hdr->layout.frame_count[i];
+		if(n)
 		{
-			size_t n = b / (hdr->car->vcount * sizeof(i16x3));
 			hdr->anims[hdr->anim_count].start = off;
 			hdr->anims[hdr->anim_count].count = n;
 			off += n; hdr->anim_count++;
 		}
 	}
+	hdr->frame_count = off;
 	if(hdr->anim_count == 0)
 	{
 		hdr->anims[0].start = 0;
 		hdr->anims[0].count = hdr->frame_count;
 		hdr->anim_count = 1;
 	}
+	hdr->total_frames   = off;
 	hdr->anim_current   = 0;
 	hdr->anim_frame_idx = 0;
 	printf("[NFO][MDL] anim_count: %zu frame_count: %zu\n", hdr->anim_count, hdr->frame_count);
 	return hdr->anim_count;
 }
 
+/* classify vertices of count frames as static or moving, frames[f * vcount + v] */
+anim_motion csm_anim_motion_create(const i16x3* frames, size_t vcount, size_t count, arena* mem)
+{
+	anim_motion dst = { .vcount = vcount, .frames = count, .mem = mem };
+	if(frames == NULL || vcount == 0 || count == 0) return dst;
+
+	bool* moves = (bool*)calloc(sizeof(bool), vcount);
+	dst.moving  = (u16*)csm_alloc(mem, sizeof(u16) * vcount);
+	if(moves == NULL || dst.moving == NULL)
+	{
+		free(moves);
+		csm_free(mem, dst.moving);
+		dst.moving = NULL;
+		return dst;
+	}
+
+	for(size_t f = 1; f < count; f++)
+	{
+		const i16x3* cur = frames + f * vcount;
+		/* whole frame equal to the first one */
+		if(memcmp(cur, frames, vcount * sizeof(i16x3)) == 0) continue;
+		for(size_t v = 0; v < vcount; v++)
+			moves[v] |= cur[v].x != frames[v].x || cur[v].y != frames[v].y || cur[v].z != frames[v].z;
+	}
+
+	for(size_t v = 0; v < vcount; v++)
+		if(moves[v]) dst.moving[dst.moving_count++] = (u16)v;
+
+	free(moves);
+	return dst;
+}
+
+anim_motion* csm_anim_motion_reset(anim_motion* dst)
+{
+	if(dst != NULL)
+	{
+		csm_free(dst->mem, dst->moving);
+		memset(dst, 0, sizeof(anim_motion));
+	}
+	return dst;
+}
+
+/* bytes not read and written per interpolated frame thanks to static vertices */
+size_t csm_anim_motion_saved(const anim_motion* src)
+{
+	const size_t still = src->vcount - src->moving_count;
+	return still * (2 * sizeof(i16x3) + 3 * sizeof(f32));
+}
+
+void csm_anim_motion_print(const anim_motion* src, size_t idx)
+{
+	const size_t still = src->vcount - src->moving_count;
+	printf("[NFO][ANI] anim: %zu frames: %zu static: %zu/%zu (%.1f%%) saved: %zu B/frame\n",
+	       idx, src->frames, still, src->vcount,
+	       src->vcount ? 100.0 * still / src->vcount : 0.0,
+	       csm_anim_motion_saved(src));
+}
+
+/* blend all vertices of f0 and f1 into dst as xyz triplets */
+void csm_anim_lerp(f32* dst, const i16x3* f0, const i16x3* f1, size_t vcount, f32 alpha)
+{
+	for(size_t v = 0; v < vcount; v++)
+		for(size_t k = 0; k < 3; k++)
+			dst[v * 3 + k] = (1 - alpha) * f0[v].xyz[k] + alpha * f1[v].xyz[k];
+}
+
+/* blend only the moving vertices, static ones keep their cached value in dst */
+void csm_anim_motion_lerp(f32* dst, const i16x3* f0, const i16x3* f1, const anim_motion* mot, f32 alpha)
+{
+	for(size_t i = 0; i < mot->moving_count; i++)
+	{
+		const size_t v = mot->moving[i];
+		for(size_t k = 0; k < 3; k++)
+			dst[v * 3 + k] = (1 - alpha) * f0[v].xyz[k] + alpha * f1[v].xyz[k];
+	}
+}
+
+/* analyse every animation of the model */
+size_t csm_model_motion_create(model* mdl)
+{
+	if(mdl == NULL || mdl->c3o == NULL || mdl->anim_frames == NULL) return 0;
+
+	const size_t vcount = mdl->c3o->vcount;
+	for(size_t i = 0; i < mdl->anim_count; i++)
+	{
+		csm_anim_motion_reset(&mdl->motion[i]);
+		mdl->motion[i] = csm_anim_motion_create(mdl->anim_frames + mdl->anims[i].start * vcount, vcount, mdl->anims[i].count, mdl->mem);
+		csm_anim_motion_print(&mdl->motion[i], i);
+	}
+	return mdl->anim_count;
+}
+
 void csm_model_format_print(enum format fmt)
 {
 	switch(fmt)
@@ -313,12 +1078,14 @@ enum format csm_model_format(const u8* buf, size_t len)
 	c3o_header*      c3o = (c3o_header*)buf;
 	car_header*      car = (car_header*)buf;
 
-	if(buf != NULL && len > 0)
+	if(buf != NULL && len >= hdr_len)
 	{
 		if(hdr_len + c3o->th * tw == len)
 			return CHASM_FORMAT_3O;
 
 		hdr_len += car_len;
+		if(len < hdr_len)
+			return CHASM_FORMAT_NONE;
 		tw       = csm_model_car_frame_count(car);
 		tw      += csm_model_car_sfx_len(car);
 
@@ -332,28 +1099,48 @@ model* csm_model_reset(model* dst)
 {
 	if(dst != NULL)
 	{
+		for(size_t i = 0; i < 20; i++)
+			csm_anim_motion_reset(&dst->motion[i]);
 
-		if(dst->data != NULL)
+		/* arena backed models release everything at once, views own nothing */
+		if(!dst->view)
 		{
-			free(dst->data);
-			dst->data = NULL;
+			if(dst->mem != NULL)
+			{
+				if(dst->mem_owned)
+					csm_arena_delete(dst->mem);
+			}
+			else
+			{
+				free(dst->data);
+				free(dst->ani_data);
+				free(dst->trgba);
+			}
 		}
-		memset(dst, sizeof(model), 1);
-		dst->tw             = 64;
-
-		if(dst->trgba)
-		{
-			free(dst->trgba);
-			dst->trgba = NULL;
-		}
-		dst->anim_frames = NULL;
+		memset(dst, 0, sizeof(model));
+		dst->tw = 64;
 	}
 	return dst;
 }
 
-model csm_model_create(u8* buf, size_t len)
+/* bytes an arena needs to hold a model of len bytes, buf only needs the header */
+size_t csm_model_mem_size(const u8* buf, size_t len)
 {
-	model dst = { .data = buf, .len = len };
+	size_t tdim = 0;
+	switch(csm_model_format(buf, len))
+	{
+		case CHASM_FORMAT_3O : tdim = ((c3o_header*)buf)->th * 64; break;
+		case CHASM_FORMAT_CAR: tdim = ((car_header*)buf)->th;      break;
+		case CHASM_FORMAT_NONE:
+		default: break;
+	}
+	return csm_arena_align(len) + csm_arena_align(tdim * sizeof(u8x4)) + 20 * csm_arena_align(256 * sizeof(u16)) + CSM_ARENA_ALIGN;
+}
+
+/* parse buf, trgba is drawn from mem when it is not NULL */
+model csm_model_create_arena(u8* buf, size_t len, arena* mem)
+{
+	model dst = { .data = buf, .len = len, .mem = mem };
 	if(dst.data == NULL && dst.len <= 0) return dst;
 
 	dst.data = buf;
@@ -373,22 +1160,22 @@ model csm_model_create(u8* buf, size_t len)
 			dst.tdim        = dst.th * dst.tw;
 			dst.tdata       = dst.data + sizeof(c3o_header);
 			dst.pal         = settings.pal;
-			dst.trgba       = tpal2rgba(dst.tdata, dst.tdim, dst.pal);
+			dst.trgba       = tpal2rgba(dst.tdata, dst.tdim, dst.pal, dst.mem);
 			dst.anim_frames = (i16x3*)(dst.tdata + dst.tdim);
 			break;
 		}
 		case CHASM_FORMAT_CAR:
 		{
 			dst.car         = (car_header*)dst.data;
-			dst.c3o         = (c3o_header*)dst.data + sizeof(car_header) - sizeof(c3o_header);
+			dst.c3o         = (c3o_header*)(dst.data + sizeof(car_header) - sizeof(c3o_header));
 			dst.tw          = 64;
 			dst.th          = dst.car->th / dst.tw;
 			dst.tdim        = dst.th * dst.tw;
 			dst.tdata       = dst.data + sizeof(car_header);
 			dst.pal         = settings.pal;
-			dst.trgba       = tpal2rgba(dst.tdata, dst.tdim, dst.pal);
-			dst.anim_frames = (i16x3*)(dst.tdata + dst.tdim);
+			dst.trgba       = tpal2rgba(dst.tdata, dst.tdim, dst.pal, dst.mem);
 			dst.anim_count  = csm_model_car_anim_count(&dst);
+			dst.anim_frames = (i16x3*)(dst.data + dst.layout.anims[0].off);
 			break;
 		}
 		case CHASM_FORMAT_NONE:
@@ -398,25 +1185,121 @@ model csm_model_create(u8* buf, size_t len)
 	return dst;
 }
 
-model csm_model_create_fn(const char* filename)
+/* take ownership of heap buffer buf */
+model csm_model_create(u8* buf, size_t len)
+{
+	return csm_model_create_arena(buf, len, NULL);
+}
+
+/* load filename into mem, or into a single owned block sized for the model when mem is NULL */
+model csm_model_create_arena_fn(const char* filename, arena* mem)
 {
 	struct stat sb;
 	model dst = {0};
+	u8 hdr[sizeof(car_header)] = {0};
 
 	/* check if file of sufficient length exists */
 	if(filename == NULL || stat(filename, &sb) != 0 || sb.st_size <= 0) return dst;
 
-	/* allocate memory for model data */
-	dst.len    = sb.st_size;
-	dst.data   = (u8*)calloc(dst.len, 1);
-	/* read file contents */
 	FILE* fp = fopen(filename, "rb");
-	long err = fread(dst.data, dst.len, 1, fp);
+	if(fp == NULL) return dst;
+
+	/* size the region from the header */
+	dst.len = sb.st_size;
+	if(mem == NULL)
+	{
+		long err = fread(hdr, dst.len < sizeof(hdr) ? dst.len : sizeof(hdr), 1, fp);
+		rewind(fp);
+		if(err != 1 || (mem = csm_arena_create(csm_model_mem_size(hdr, dst.len))) == NULL) { fclose(fp); return dst; }
+		dst.mem_owned = true;
+	}
+	dst.mem  = mem;
+
+	/* read file contents */
+	dst.data = (u8*)csm_arena_alloc(dst.mem, dst.len);
+	long err = dst.data ? fread(dst.data, dst.len, 1, fp) : 0;
 	fclose(fp);
 	if (err != 1) { csm_model_reset(&dst); return dst; }
 
 	/* parse model header */
-	return csm_model_create(dst.data, dst.len);
+	model mdl = csm_model_create_arena(dst.data, dst.len, dst.mem);
+	mdl.mem_owned = dst.mem_owned;
+	if(mdl.fmt == CHASM_FORMAT_NONE && dst.mem_owned)
+		csm_arena_delete(dst.mem);
+	return mdl;
+}
+
+model csm_model_create_fn(const char* filename)
+{
+	return csm_model_create_arena_fn(filename, NULL);
+}
+
+/* attach .ANI animation frames to a .3O model */
+size_t csm_model_ani_create_fn(model* dst, const char* filename)
+{
+	struct stat sb;
+
+	if(dst == NULL || dst->fmt != CHASM_FORMAT_3O || dst->c3o->vcount == 0) return 0;
+	if(filename == NULL || stat(filename, &sb) != 0 || sb.st_size <= 0) return 0;
+
+	FILE* fp = fopen(filename, "rb");
+	if(fp == NULL) return 0;
+
+	u8* buf  = (u8*)csm_alloc(dst->mem, sb.st_size);
+	long err = buf ? fread(buf, sb.st_size, 1, fp) : 0;
+	fclose(fp);
+	if(err != 1) { csm_free(dst->mem, buf); return 0; }
+
+	const size_t vcount = dst->c3o->vcount;
+	const size_t off    = (*(u16*)buf == vcount) ? 2 : 0;
+
+	/* moving lists of the old frames would be trusted by csm_anim_eval */
+	for(size_t i = 0; i < 20; i++)
+		csm_anim_motion_reset(&dst->motion[i]);
+	csm_free(dst->mem, dst->ani_data);
+	dst->ani_data        = buf;
+	dst->ani_len         = sb.st_size;
+	dst->anim_frames     = (i16x3*)(buf + off);
+	dst->total_frames    = (dst->ani_len - off) / (sizeof(i16x3) * vcount);
+	dst->anims[0].start  = 0;
+	dst->anims[0].count  = dst->total_frames;
+	dst->anim_count      = dst->total_frames ? 1 : 0;
+	dst->anim_current    = 0;
+	dst->anim_frame_idx  = 0;
+	printf("[NFO][ANI] %s frames: %zu\n", filename, dst->total_frames);
+	return dst->total_frames;
+}
+
+/* zero-copy model of sub-model i of a .CAR, its two spans become animations 0 and 1 */
+model csm_model_sub_create(const model* car, size_t i)
+{
+	model dst = {0};
+	if(car == NULL || car->fmt != CHASM_FORMAT_CAR || i >= 6 || car->layout.sub[i].hdr == NULL) return dst;
+
+	const car_sub_model* sub = &car->layout.sub[i];
+	dst.view        = true;
+	dst.data        = car->data;
+	dst.len         = car->len;
+	dst.fmt         = CHASM_FORMAT_3O;
+	dst.c3o         = sub->hdr;
+	dst.tw          = car->tw;
+	dst.th          = car->th;
+	dst.tdim        = car->tdim;
+	dst.tdata       = car->tdata;
+	dst.pal         = car->pal;
+	dst.trgba       = car->trgba;
+	dst.anim_frames = (i16x3*)(car->data + sub->frames[0].off);
+	for(size_t k = 0; k < 2; k++)
+	{
+		if(sub->frame_count[k] == 0) continue;
+		dst.anims[dst.anim_count].start = dst.total_frames;
+		dst.anims[dst.anim_count].count = sub->frame_count[k];
+		dst.total_frames += sub->frame_count[k];
+		dst.anim_count++;
+	}
+	dst.frame_count = dst.total_frames;
+	snprintf(dst.name, sizeof(dst.name), "%s#%zu", car->name, i);
+	return dst;
 }
 
 model* csm_model_delete(model* ptr)
@@ -430,6 +1313,685 @@ model* csm_model_delete(model* ptr)
 	return ptr;
 }
 
+/* corner vertex indices of triangle id, quads split as 0,1,2 and 0,2,3 */
+static inline void csm_bvh_tri(const bvh* b, u32 id, u16 vi[3])
+{
+	const face* f = &b->faces[id >> 1];
+	vi[0] = f->vi[0];
+	vi[1] = f->vi[(id & 1) ? 2 : 1];
+	vi[2] = f->vi[(id & 1) ? 3 : 2];
+}
+
+static inline f32 csm_bvh_centroid(const bvh* b, const f32* pos, u32 id, size_t axis)
+{
+	u16 vi[3];
+	csm_bvh_tri(b, id, vi);
+	return pos[vi[0] * 3 + axis] + pos[vi[1] * 3 + axis] + pos[vi[2] * 3 + axis];
+}
+
+/* recompute node bounds bottom-up, children always follow their parent */
+void csm_bvh_refit(bvh* b, const f32* pos)
+{
+	if(b == NULL || pos == NULL) return;
+
+	for(size_t n = b->node_count; n-- > 0;)
+	{
+		bvh_node* node = &b->nodes[n];
+		for(size_t k = 0; k < 3; k++) { node->min[k] = INFINITY; node->max[k] = -INFINITY; }
+		if(node->count)
+		{
+			for(u32 i = node->first; i < node->first + node->count; i++)
+			{
+				u16 vi[3];
+				csm_bvh_tri(b, b->tris[i], vi);
+				for(size_t c = 0; c < 3; c++)
+					for(size_t k = 0; k < 3; k++)
+					{
+						const f32 x = pos[vi[c] * 3 + k];
+						node->min[k] = x < node->min[k] ? x : node->min[k];
+						node->max[k] = x > node->max[k] ? x : node->max[k];
+					}
+			}
+		}
+		else
+		{
+			const bvh_node* l = &b->nodes[node->first];
+			const bvh_node* r = &b->nodes[node->first + 1];
+			for(size_t k = 0; k < 3; k++)
+			{
+				node->min[k] = l->min[k] < r->min[k] ? l->min[k] : r->min[k];
+				node->max[k] = l->max[k] > r->max[k] ? l->max[k] : r->max[k];
+			}
+		}
+	}
+}
+
+bvh* csm_bvh_delete(bvh* b)
+{
+	if(b != NULL)
+	{
+		free(b->nodes);
+		free(b->tris);
+		free(b);
+		b = NULL;
+	}
+	return b;
+}
+
+/* build over fcount faces with xyz positions pos, topology is kept and only refit afterwards */
+bvh* csm_bvh_create(const face* faces, size_t fcount, size_t vcount, const f32* pos)
+{
+	if(faces == NULL || pos == NULL || fcount == 0) return NULL;
+
+	bvh* b = (bvh*)calloc(sizeof(bvh), 1);
+	if(b == NULL) return NULL;
+	b->faces  = faces;
+	b->vcount = vcount;
+	b->tris   = (u32*)calloc(sizeof(u32), fcount * 2);
+	b->nodes  = (bvh_node*)calloc(sizeof(bvh_node), fcount * 4);
+	if(b->tris == NULL || b->nodes == NULL) return csm_bvh_delete(b);
+
+	for(size_t i = 0; i < fcount; i++)
+	{
+		if(faces[i].vi[0] >= vcount || faces[i].vi[1] >= vcount || faces[i].vi[2] >= vcount) continue;
+		b->tris[b->tri_count++] = (u32)(i * 2);
+		if(faces[i].vi[3] < vcount)
+			b->tris[b->tri_count++] = (u32)(i * 2 + 1);
+	}
+	if(b->tri_count == 0) return csm_bvh_delete(b);
+
+	/* median split on the widest centroid axis, nodes are processed in creation order */
+	b->nodes[0].first = 0;
+	b->nodes[0].count = (u32)b->tri_count;
+	b->node_count     = 1;
+	for(size_t n = 0; n < b->node_count; n++)
+	{
+		bvh_node* node = &b->nodes[n];
+		if(node->count <= CSM_BVH_LEAF) continue;
+
+		f32 lo[3] = { INFINITY, INFINITY, INFINITY }, hi[3] = { -INFINITY, -INFINITY, -INFINITY };
+		for(u32 i = node->first; i < node->first + node->count; i++)
+			for(size_t k = 0; k < 3; k++)
+			{
+				const f32 c = csm_bvh_centroid(b, pos, b->tris[i], k);
+				lo[k] = c < lo[k] ? c : lo[k];
+				hi[k] = c > hi[k] ? c : hi[k];
+			}
+		size_t axis = 0;
+		for(size_t k = 1; k < 3; k++)
+			if(hi[k] - lo[k] > hi[axis] - lo[axis]) axis = k;
+
+		/* insertion sort of the range by centroid, ranges are small */
+		u32* t = b->tris + node->first;
+		for(u32 i = 1; i < node->count; i++)
+		{
+			const u32 id = t[i];
+			const f32 c  = csm_bvh_centroid(b, pos, id, axis);
+			u32 j = i;
+			for(; j > 0 && csm_bvh_centroid(b, pos, t[j - 1], axis) > c; j--)
+				t[j] = t[j - 1];
+			t[j] = id;
+		}
+
+		const u32 half = node->count / 2;
+		bvh_node* l = &b->nodes[b->node_count];
+		bvh_node* r = &b->nodes[b->node_count + 1];
+		l->first = node->first;        l->count = half;
+		r->first = node->first + half; r->count = node->count - half;
+		node->first = (u32)b->node_count;
+		node->count = 0;
+		b->node_count += 2;
+	}
+	csm_bvh_refit(b, pos);
+	return b;
+}
+
+static inline bool csm_bvh_slab(const bvh_node* n, const f32 org[3], const f32 inv[3], f32 tmax)
+{
+	f32 t0 = 0, t1 = tmax;
+	for(size_t k = 0; k < 3; k++)
+	{
+		f32 a = (n->min[k] - org[k]) * inv[k];
+		f32 b = (n->max[k] - org[k]) * inv[k];
+		if(a > b) { const f32 x = a; a = b; b = x; }
+		t0 = a > t0 ? a : t0;
+		t1 = b < t1 ? b : t1;
+		if(t0 > t1) return false;
+	}
+	return true;
+}
+
+/* nearest triangle hit by the ray org + t * dir, t > 0, faces without any of flags are skipped (0 takes all) */
+bvh_hit csm_bvh_raycast(const bvh* b, const f32* pos, const f32 org[3], const f32 dir[3], u8 flags)
+{
+	bvh_hit dst = { .t = INFINITY };
+	if(b == NULL || pos == NULL) return dst;
+
+	const f32 inv[3] = { 1.0f / dir[0], 1.0f / dir[1], 1.0f / dir[2] };
+	u32    stack[64];
+	size_t top = 0;
+	stack[top++] = 0;
+	while(top > 0)
+	{
+		const bvh_node* n = &b->nodes[stack[--top]];
+		if(!csm_bvh_slab(n, org, inv, dst.t)) continue;
+		if(n->count == 0)
+		{
+			if(top + 2 > 64) continue;
+			stack[top++] = n->first;
+			stack[top++] = n->first + 1;
+			continue;
+		}
+		for(u32 i = n->first; i < n->first + n->count; i++)
+		{
+			/* Moeller-Trumbore, both sides */
+			if(flags && !(b->faces[b->tris[i] >> 1].conf.flags & flags)) continue;
+			u16 vi[3];
+			csm_bvh_tri(b, b->tris[i], vi);
+			const f32* p0 = pos + vi[0] * 3;
+			const f32* p1 = pos + vi[1] * 3;
+			const f32* p2 = pos + vi[2] * 3;
+			const f32 e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			const f32 e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			const f32 pv[3] = { dir[1] * e2[2] - dir[2] * e2[1], dir[2] * e2[0] - dir[0] * e2[2], dir[0] * e2[1] - dir[1] * e2[0] };
+			const f32 det   = e1[0] * pv[0] + e1[1] * pv[1] + e1[2] * pv[2];
+			if(fabsf(det) < 1e-12f) continue;
+			const f32 id    = 1.0f / det;
+			const f32 tv[3] = { org[0] - p0[0], org[1] - p0[1], org[2] - p0[2] };
+			const f32 u     = (tv[0] * pv[0] + tv[1] * pv[1] + tv[2] * pv[2]) * id;
+			if(u < 0 || u > 1) continue;
+			const f32 qv[3] = { tv[1] * e1[2] - tv[2] * e1[1], tv[2] * e1[0] - tv[0] * e1[2], tv[0] * e1[1] - tv[1] * e1[0] };
+			const f32 v     = (dir[0] * qv[0] + dir[1] * qv[1] + dir[2] * qv[2]) * id;
+			if(v < 0 || u + v > 1) continue;
+			const f32 t     = (e2[0] * qv[0] + e2[1] * qv[1] + e2[2] * qv[2]) * id;
+			if(t <= 0 || t >= dst.t) continue;
+			dst = (bvh_hit){ .hit = true, .face = b->tris[i] >> 1, .half = (u8)(b->tris[i] & 1), .t = t, .u = u, .v = v };
+		}
+	}
+	return dst;
+}
+
+/* closest point on triangle a,b,c to p (Ericson, Real-Time Collision Detection 5.1.5) */
+void csm_closest_on_tri(const f32 p[3], const f32 a[3], const f32 b[3], const f32 c[3], f32 dst[3])
+{
+	f32 ab[3], ac[3], ap[3], bp[3], cp[3];
+	for(size_t k = 0; k < 3; k++) { ab[k] = b[k] - a[k]; ac[k] = c[k] - a[k]; ap[k] = p[k] - a[k]; bp[k] = p[k] - b[k]; cp[k] = p[k] - c[k]; }
+	const f32 d1 = ab[0] * ap[0] + ab[1] * ap[1] + ab[2] * ap[2], d2 = ac[0] * ap[0] + ac[1] * ap[1] + ac[2] * ap[2];
+	const f32 d3 = ab[0] * bp[0] + ab[1] * bp[1] + ab[2] * bp[2], d4 = ac[0] * bp[0] + ac[1] * bp[1] + ac[2] * bp[2];
+	const f32 d5 = ab[0] * cp[0] + ab[1] * cp[1] + ab[2] * cp[2], d6 = ac[0] * cp[0] + ac[1] * cp[1] + ac[2] * cp[2];
+	const f32 va = d3 * d6 - d5 * d4, vb = d5 * d2 - d1 * d6, vc = d1 * d4 - d3 * d2;
+	f32 v = 0, w = 0;
+
+	if(d1 <= 0 && d2 <= 0)                        { v = 0; w = 0; }
+	else if(d3 >= 0 && d4 <= d3)                  { v = 1; w = 0; }
+	else if(d6 >= 0 && d5 <= d6)                  { v = 0; w = 1; }
+	else if(vc <= 0 && d1 >= 0 && d3 <= 0)        { v = d1 / (d1 - d3); w = 0; }
+	else if(vb <= 0 && d2 >= 0 && d6 <= 0)        { v = 0; w = d2 / (d2 - d6); }
+	else if(va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0)
+	{
+		w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		v = 1 - w;
+	}
+	else
+	{
+		const f32 den = 1.0f / (va + vb + vc);
+		v = vb * den;
+		w = vc * den;
+	}
+	for(size_t k = 0; k < 3; k++)
+		dst[k] = a[k] + ab[k] * v + ac[k] * w;
+}
+
+/* triangle closest to p, t is the distance, flags filter faces as in csm_bvh_raycast */
+bvh_hit csm_bvh_closest(const bvh* b, const f32* pos, const f32 p[3], u8 flags)
+{
+	bvh_hit dst = { .t = INFINITY };
+	if(b == NULL || pos == NULL) return dst;
+
+	f32    best = INFINITY;
+	u32    stack[64];
+	size_t top = 0;
+	stack[top++] = 0;
+	while(top > 0)
+	{
+		const bvh_node* n = &b->nodes[stack[--top]];
+		/* squared distance from p to the box */
+		f32 d = 0;
+		for(size_t k = 0; k < 3; k++)
+		{
+			const f32 e = p[k] < n->min[k] ? n->min[k] - p[k] : (p[k] > n->max[k] ? p[k] - n->max[k] : 0);
+			d += e * e;
+		}
+		if(d >= best) continue;
+		if(n->count == 0)
+		{
+			if(top + 2 > 64) continue;
+			stack[top++] = n->first;
+			stack[top++] = n->first + 1;
+			continue;
+		}
+		for(u32 i = n->first; i < n->first + n->count; i++)
+		{
+			if(flags && !(b->faces[b->tris[i] >> 1].conf.flags & flags)) continue;
+			u16 vi[3];
+			f32 q[3];
+			csm_bvh_tri(b, b->tris[i], vi);
+			csm_closest_on_tri(p, pos + vi[0] * 3, pos + vi[1] * 3, pos + vi[2] * 3, q);
+			const f32 dd = (q[0] - p[0]) * (q[0] - p[0]) + (q[1] - p[1]) * (q[1] - p[1]) + (q[2] - p[2]) * (q[2] - p[2]);
+			if(dd < best)
+			{
+				best = dd;
+				dst  = (bvh_hit){ .hit = true, .face = b->tris[i] >> 1, .half = (u8)(b->tris[i] & 1) };
+			}
+		}
+	}
+	dst.t = sqrtf(best);
+	return dst;
+}
+
+bvh* csm_model_bvh_create(const model* mdl, const f32* pos)
+{
+	if(mdl == NULL || mdl->c3o == NULL) return NULL;
+	return csm_bvh_create(mdl->c3o->faces, mdl->c3o->fcount, mdl->c3o->vcount, pos);
+}
+
+void csm_bvh_print(const bvh* b)
+{
+	if(b == NULL || b->node_count == 0) return;
+	size_t leaves = 0, depth = 0;
+	for(size_t n = 0; n < b->node_count; n++)
+		leaves += b->nodes[n].count > 0;
+	for(size_t n = b->tri_count; n > CSM_BVH_LEAF; n = (n + 1) / 2)
+		depth++;
+	printf("[NFO][BVH] tris: %zu nodes: %zu leaves: %zu depth: %zu bounds: [%.1f %.1f %.1f] [%.1f %.1f %.1f]\n",
+	       b->tri_count, b->node_count, leaves, depth,
+	       b->nodes[0].min[0], b->nodes[0].min[1], b->nodes[0].min[2],
+	       b->nodes[0].max[0], b->nodes[0].max[1], b->nodes[0].max[2]);
+}
+
+/* case insensitive FNV-1a of an archive entry name */
+u32 csm_archive_hash(const char* name)
+{
+	u32 h = 2166136261u;
+	for(size_t i = 0; i < CSM_ARCHIVE_NAME && name[i] != '\0'; i++)
+	{
+		const u8 c = (u8)name[i];
+		h ^= (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+bool csm_archive_name_eq(const char* a, const char* b)
+{
+	for(size_t i = 0; i < CSM_ARCHIVE_NAME; i++)
+	{
+		const u8 ca = (u8)a[i], cb = (u8)b[i];
+		if(((ca >= 'a' && ca <= 'z') ? ca - 'a' + 'A' : ca) != ((cb >= 'a' && cb <= 'z') ? cb - 'a' + 'A' : cb)) return false;
+		if(ca == '\0') return true;
+	}
+	return true;
+}
+
+archive* csm_archive_delete(archive* ar)
+{
+	if(ar != NULL)
+	{
+#ifndef _WIN32
+		if(ar->mapped)
+			munmap(ar->data, ar->len);
+		else
+#endif
+		free(ar->data);
+		free(ar->entries);
+		free(ar->index);
+		free(ar);
+		ar = NULL;
+	}
+	return ar;
+}
+
+/* map a resource archive and index its entries, NULL if it is none */
+archive* csm_archive_create_fn(const char* filename)
+{
+	struct stat sb;
+	const size_t hdr_len = 6, ent_len = 1 + CSM_ARCHIVE_NAME + 4 + 4;
+
+	if(filename == NULL || stat(filename, &sb) != 0 || (size_t)sb.st_size < hdr_len) return NULL;
+
+	archive* ar = (archive*)calloc(sizeof(archive), 1);
+	if(ar == NULL) return NULL;
+	ar->len = sb.st_size;
+
+#ifndef _WIN32
+	/* private writable mapping, models never write but stay safe if they do */
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0) return csm_archive_delete(ar);
+	ar->data = (u8*)mmap(NULL, ar->len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(ar->data == MAP_FAILED) { ar->data = NULL; return csm_archive_delete(ar); }
+	ar->mapped = true;
+#else
+	FILE* fp = fopen(filename, "rb");
+	if(fp == NULL) return csm_archive_delete(ar);
+	ar->data = (u8*)malloc(ar->len);
+	long err = ar->data ? fread(ar->data, ar->len, 1, fp) : 0;
+	fclose(fp);
+	if(err != 1) return csm_archive_delete(ar);
+#endif
+
+	if(memcmp(ar->data, CSM_ARCHIVE_MAGIC, 4) != 0) return csm_archive_delete(ar);
+	ar->count = *(u16*)(ar->data + 4);
+	if(hdr_len + ar->count * ent_len > ar->len) return csm_archive_delete(ar);
+
+	/* power of two table at most half full */
+	ar->slots = 16;
+	while(ar->slots < ar->count * 2) ar->slots <<= 1;
+	ar->entries = (archive_entry*)calloc(sizeof(archive_entry), ar->count ? ar->count : 1);
+	ar->index   = (u32*)calloc(sizeof(u32), ar->slots);
+	if(ar->entries == NULL || ar->index == NULL) return csm_archive_delete(ar);
+
+	for(size_t i = 0; i < ar->count; i++)
+	{
+		const u8*      src = ar->data + hdr_len + i * ent_len;
+		archive_entry* dst = &ar->entries[i];
+		const size_t   len = src[0] < CSM_ARCHIVE_NAME ? src[0] : CSM_ARCHIVE_NAME;
+		memcpy(dst->name, src + 1, len);
+		dst->len = *(u32*)(src + 1 + CSM_ARCHIVE_NAME);
+		dst->off = *(u32*)(src + 1 + CSM_ARCHIVE_NAME + 4);
+		if(dst->off > ar->len || dst->len > ar->len - dst->off) return csm_archive_delete(ar);
+
+		/* first entry of a duplicated name wins */
+		size_t h = csm_archive_hash(dst->name) & (ar->slots - 1);
+		while(ar->index[h] != 0 && !csm_archive_name_eq(ar->entries[ar->index[h] - 1].name, dst->name))
+			h = (h + 1) & (ar->slots - 1);
+		if(ar->index[h] == 0)
+			ar->index[h] = (u32)(i + 1);
+	}
+	printf("[NFO][BIN] %s entries: %zu\n", filename, ar->count);
+	return ar;
+}
+
+const archive_entry* csm_archive_find(const archive* ar, const char* name)
+{
+	if(ar == NULL || name == NULL) return NULL;
+
+	size_t h = csm_archive_hash(name) & (ar->slots - 1);
+	while(ar->index[h] != 0)
+	{
+		const archive_entry* e = &ar->entries[ar->index[h] - 1];
+		if(csm_archive_name_eq(e->name, name)) return e;
+		h = (h + 1) & (ar->slots - 1);
+	}
+	return NULL;
+}
+
+const archive_entry* csm_archive_entry_at(const archive* ar, size_t i)
+{
+	return (ar != NULL && i < ar->count) ? &ar->entries[i] : NULL;
+}
+
+/* zero-copy slice of an entry, valid until the archive is deleted */
+u8* csm_archive_data(const archive* ar, const archive_entry* e)
+{
+	return (ar != NULL && e != NULL) ? ar->data + e->off : NULL;
+}
+
+/* true if the entry name ends in ext, case insensitive */
+bool csm_archive_entry_is(const archive_entry* e, const char* ext)
+{
+	const size_t n = strlen(e->name), m = strlen(ext);
+	return n >= m && csm_archive_name_eq(e->name + n - m, ext);
+}
+
+void csm_archive_print(const archive* ar)
+{
+	for(size_t i = 0; ar != NULL && i < ar->count; i++)
+		printf("[NFO][BIN] %-12s len: %8zu off: %8zu\n", ar->entries[i].name, ar->entries[i].len, ar->entries[i].off);
+}
+
+/* palette entry name, or the first .pal/.act entry when name is NULL */
+palette* csm_archive_palette_create(const archive* ar, const char* name)
+{
+	const archive_entry* e = csm_archive_find(ar, name);
+	for(size_t i = 0; e == NULL && name == NULL && ar != NULL && i < ar->count; i++)
+		if(csm_archive_entry_is(&ar->entries[i], ".PAL") || csm_archive_entry_is(&ar->entries[i], ".ACT"))
+			e = &ar->entries[i];
+	if(e == NULL) return NULL;
+	printf("[NFO][PAL] %s\n", e->name);
+	return csm_palette_create(csm_archive_data(ar, e), e->len);
+}
+
+/* model viewing entry e of the archive in place, trgba comes from mem or an owned arena */
+model csm_archive_model_create_entry(const archive* ar, const archive_entry* e, arena* mem)
+{
+	model dst = {0};
+	u8*   buf = csm_archive_data(ar, e);
+	if(buf == NULL || e->len < sizeof(c3o_header)) return dst;
+
+	const bool owned = mem == NULL;
+	if(owned && (mem = csm_arena_create(csm_model_mem_size(buf, e->len) - csm_arena_align(e->len))) == NULL) return dst;
+
+	dst = csm_model_create_arena(buf, e->len, mem);
+	dst.mem_owned = owned;
+	if(dst.fmt == CHASM_FORMAT_NONE && owned)
+		csm_arena_delete(mem);
+	snprintf(dst.name, sizeof(dst.name), "%s", e->name);
+	return dst;
+}
+
+/* model of the first entry called name */
+model csm_archive_model_create(const archive* ar, const char* name, arena* mem)
+{
+	return csm_archive_model_create_entry(ar, csm_archive_find(ar, name), mem);
+}
+
+/* unit normal of triangle a b c into n */
+static inline void csm_tri_normal(const f32* pos, size_t ia, size_t ib, size_t ic, f32 n[3])
+{
+	const f32* a  = pos + ia * 3;
+	const f32* b  = pos + ib * 3;
+	const f32* c  = pos + ic * 3;
+	const f32 u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+	const f32 v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+	n[0] = u[1] * v[2] - u[2] * v[1];
+	n[1] = u[2] * v[0] - u[0] * v[2];
+	n[2] = u[0] * v[1] - u[1] * v[0];
+	const f32 len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+	if(len > 0) { n[0] /= len; n[1] /= len; n[2] /= len; }
+}
+
+/* evaluate positions and triangle normals of tick into dst, ticks_per_frame ticks blend f0 to f1 */
+anim_output* csm_anim_eval(const model* mdl, size_t anim, size_t tick, size_t ticks_per_frame, anim_output* dst)
+{
+	if(mdl == NULL || mdl->c3o == NULL || dst == NULL || dst->pos == NULL) return NULL;
+
+	const size_t vcount = mdl->c3o->vcount;
+	const i16x3*     f0 = mdl->c3o->overt;
+	const i16x3*     f1 = mdl->c3o->overt;
+	f32           alpha = 0;
+
+	if(anim < mdl->anim_count && mdl->anims[anim].count > 0 && ticks_per_frame > 0)
+	{
+		const size_t frame = tick / ticks_per_frame;
+		const size_t count = mdl->anims[anim].count;
+		f0    = mdl->anim_frames + (mdl->anims[anim].start + frame % count) * vcount;
+		f1    = mdl->anim_frames + (mdl->anims[anim].start + (frame + 1) % count) * vcount;
+		alpha = (f32)(tick % ticks_per_frame) / ticks_per_frame;
+	}
+
+	/* static vertices of a slot stay valid while it keeps the same animation */
+	if(dst->tick != CSM_ANIM_NONE && dst->anim == anim && anim < mdl->anim_count && mdl->motion[anim].moving != NULL)
+		csm_anim_motion_lerp(dst->pos, f0, f1, &mdl->motion[anim], alpha);
+	else
+		csm_anim_lerp(dst->pos, f0, f1, vcount, alpha);
+
+	for(size_t i = 0; dst->nrm != NULL && i < mdl->c3o->fcount; i++)
+	{
+		const u16* vi = mdl->c3o->faces[i].vi;
+		if(vi[0] >= vcount || vi[1] >= vcount || vi[2] >= vcount) continue;
+		csm_tri_normal(dst->pos, vi[0], vi[1], vi[2], dst->nrm + i * 6);
+		if(vi[3] < vcount)
+			csm_tri_normal(dst->pos, vi[0], vi[2], vi[3], dst->nrm + i * 6 + 3);
+	}
+	dst->anim = anim;
+	dst->tick = tick;
+	return dst;
+}
+
+/* render thread: latest published output of the instance, NULL when none is ready */
+anim_output* csm_anim_instance_acquire(anim_instance* inst)
+{
+	if(atomic_load_explicit(&inst->ready, memory_order_acquire) & CSM_ANIM_FRESH)
+		inst->read = atomic_exchange_explicit(&inst->ready, inst->read, memory_order_acq_rel) & 3;
+	return inst->out[inst->read].tick == CSM_ANIM_NONE ? NULL : &inst->out[inst->read];
+}
+
+/* worker thread: evaluate tick into the private slot and hand it over */
+void csm_anim_instance_publish(anim_instance* inst, size_t tick, size_t ticks_per_frame)
+{
+	csm_anim_eval(inst->mdl, inst->work_anim, tick, ticks_per_frame, &inst->out[inst->write]);
+	inst->write = atomic_exchange_explicit(&inst->ready, inst->write | CSM_ANIM_FRESH, memory_order_acq_rel) & 3;
+}
+
+typedef struct anim_worker { anim_pool* pool; size_t idx; } anim_worker;
+
+void* csm_anim_pool_worker(void* arg)
+{
+	anim_worker* w    = (anim_worker*)arg;
+	anim_pool*   pool = w->pool;
+	size_t       seen = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	for(;;)
+	{
+		while(!pool->stop && pool->generation == seen)
+			pthread_cond_wait(&pool->wake, &pool->lock);
+		if(pool->stop) break;
+		seen = pool->generation;
+		const size_t tick = pool->target;
+		for(size_t i = w->idx; i < pool->count; i += pool->workers)
+			pool->instances[i].work_anim = pool->instances[i].anim;
+		pthread_mutex_unlock(&pool->lock);
+
+		/* each worker owns every workers-th instance */
+		for(size_t i = w->idx; i < pool->count; i += pool->workers)
+			csm_anim_instance_publish(&pool->instances[i], tick, pool->ticks_per_frame);
+
+		pthread_mutex_lock(&pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	free(w);
+	return NULL;
+}
+
+anim_pool* csm_anim_pool_delete(anim_pool* pool);
+
+/* start workers animating count models, ticks_per_frame ticks per keyframe */
+anim_pool* csm_anim_pool_create(model* mdls, size_t count, size_t workers, size_t ticks_per_frame)
+{
+	if(mdls == NULL || count == 0 || workers == 0 || ticks_per_frame == 0) return NULL;
+
+	anim_pool* pool = (anim_pool*)calloc(sizeof(anim_pool), 1);
+	if(pool == NULL) return NULL;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	pool->instances       = (anim_instance*)calloc(sizeof(anim_instance), count);
+	pool->threads         = (pthread_t*)calloc(sizeof(pthread_t), workers);
+	if(pool->instances == NULL || pool->threads == NULL) return csm_anim_pool_delete(pool);
+	pool->count           = count;
+	pool->ticks_per_frame = ticks_per_frame;
+
+	for(size_t i = 0; i < count; i++)
+	{
+		anim_instance* inst = &pool->instances[i];
+		inst->mdl   = &mdls[i];
+		inst->write = 1;
+		inst->read  = 2;
+		atomic_store_explicit(&inst->ready, 0, memory_order_relaxed);
+		for(size_t k = 0; k < 3; k++)
+		{
+			const size_t vcount = mdls[i].c3o ? mdls[i].c3o->vcount : 0;
+			const size_t fcount = mdls[i].c3o ? mdls[i].c3o->fcount : 0;
+			inst->out[k].pos  = (f32*)calloc(sizeof(f32) * 3, vcount ? vcount : 1);
+			inst->out[k].nrm  = (f32*)calloc(sizeof(f32) * 6, fcount ? fcount : 1);
+			inst->out[k].tick = CSM_ANIM_NONE;
+			if(inst->out[k].pos == NULL || inst->out[k].nrm == NULL) return csm_anim_pool_delete(pool);
+		}
+	}
+
+	for(size_t i = 0; i < workers; i++)
+	{
+		anim_worker* w = (anim_worker*)calloc(sizeof(anim_worker), 1);
+		if(w == NULL) break;
+		w->pool = pool;
+		w->idx  = i;
+		if(pthread_create(&pool->threads[i], NULL, csm_anim_pool_worker, w) != 0)
+		{
+			free(w);
+			break;
+		}
+		pool->workers++;
+	}
+	if(pool->workers == 0) return csm_anim_pool_delete(pool);
+	return pool;
+}
+
+/* ask the workers to prepare tick, returns immediately */
+void csm_anim_pool_request(anim_pool* pool, size_t tick)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->target = tick;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/* switch instance i to anim, workers pick it up with the next request */
+void csm_anim_pool_play(anim_pool* pool, size_t i, size_t anim)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->instances[i].anim = anim;
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/* output of instance i for tick, evaluated on the calling thread when the workers fell behind */
+anim_output* csm_anim_pool_output(anim_pool* pool, size_t i, size_t tick)
+{
+	anim_instance* inst = &pool->instances[i];
+	anim_output*   dst  = csm_anim_instance_acquire(inst);
+	if(dst == NULL || dst->tick != tick || dst->anim != inst->anim)
+		dst = csm_anim_eval(inst->mdl, inst->anim, tick, pool->ticks_per_frame, &inst->out[inst->read]);
+	return dst;
+}
+
+anim_pool* csm_anim_pool_delete(anim_pool* pool)
+{
+	if(pool != NULL)
+	{
+		pthread_mutex_lock(&pool->lock);
+		pool->stop = true;
+		pthread_cond_broadcast(&pool->wake);
+		pthread_mutex_unlock(&pool->lock);
+		for(size_t i = 0; i < pool->workers; i++)
+			pthread_join(pool->threads[i], NULL);
+
+		for(size_t i = 0; i < pool->count; i++)
+			for(size_t k = 0; k < 3; k++)
+			{
+				free(pool->instances[i].out[k].pos);
+				free(pool->instances[i].out[k].nrm);
+			}
+		pthread_cond_destroy(&pool->wake);
+		pthread_mutex_destroy(&pool->lock);
+		free(pool->instances);
+		free(pool->threads);
+		free(pool);
+		pool = NULL;
+	}
+	return pool;
+}
+
 #ifdef __cplusplus
 };
 #endif
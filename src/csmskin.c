@@ -0,0 +1,85 @@
+#include <chasm/chasm.h>
+#include <png.h>
+#include <time.h>
+
+/* csmskin <model.car|model.3o> <skin.png> <out> [none|ordered|floyd] */
+int main(int argc, char** argv)
+{
+	if(argc < 4)
+	{
+		fprintf(stderr, "Usage: %s <model> <skin.png> <out> [none|ordered|floyd]\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	enum dither mode = CSM_DITHER_NONE;
+	if(argc > 4 && strcmp(argv[4], "ordered") == 0) mode = CSM_DITHER_ORDERED;
+	if(argc > 4 && strcmp(argv[4], "floyd")   == 0) mode = CSM_DITHER_FLOYD;
+
+	/* load default palette */
+	settings.pal = csm_palette_create_fn("assets/chasmpalette.act");
+	if(settings.pal == NULL) exit(EXIT_FAILURE);
+
+	model mdl = csm_model_create_fn(argv[1]);
+	csm_model_format_print(mdl.fmt);
+	if(mdl.fmt == CHASM_FORMAT_NONE) exit(EXIT_FAILURE);
+
+	/* decode skin as RGBA, width must match the model */
+	png_image img = { .version = PNG_IMAGE_VERSION };
+	if(!png_image_begin_read_from_file(&img, argv[2]))
+	{
+		fprintf(stderr, "[ERR][PNG] %s: %s\n", argv[2], img.message);
+		exit(EXIT_FAILURE);
+	}
+	img.format = PNG_FORMAT_RGBA;
+	const size_t h = img.height;
+	const size_t w = img.width;
+	u8x4* rgba = (u8x4*)calloc(sizeof(u8x4), w * h);
+	u8*   skin = (u8*)calloc(1, w * h);
+	if(w != (size_t)mdl.tw || h == 0 || h * w > UINT16_MAX * (mdl.fmt == CHASM_FORMAT_3O ? w : 1) ||
+	   !png_image_finish_read(&img, NULL, rgba, 0, NULL))
+	{
+		fprintf(stderr, "[ERR][PNG] %s: %zux%zu skin, expected width %d\n", argv[2], w, h, mdl.tw);
+		exit(EXIT_FAILURE);
+	}
+	printf("[NFO][PNG] %s %zux%zu\n", argv[2], w, h);
+
+	/* quantize and time it */
+	struct timespec t0, t1, t2;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	quantizer* q = csm_quantizer_create(settings.pal, csm_palette_transparent_index(settings.pal, mdl.fmt));
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	if(q == NULL) exit(EXIT_FAILURE);
+	const size_t px = csm_quantize(q, rgba, w, h, skin, mode);
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	const double lut = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+	const double sec = (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) * 1e-9;
+	printf("[NFO][QNT] lut: %.1f ms transparent: %u pixels: %zu time: %.3f ms rate: %.1f Mpx/s\n", lut * 1e3, q->transparent, px, sec * 1e3, sec > 0 ? px / sec * 1e-6 : 0.0);
+
+	/* header with new skin height, new skin, everything after the old skin */
+	const size_t hdr_len = mdl.tdata - mdl.data;
+	const size_t tail    = mdl.len - hdr_len - mdl.tdim;
+	u8* hdr = (u8*)malloc(hdr_len);
+	memcpy(hdr, mdl.data, hdr_len);
+	if(mdl.fmt == CHASM_FORMAT_3O)
+		((c3o_header*)hdr)->th = (u16)h;
+	else
+		((car_header*)hdr)->th = (u16)(h * w);
+
+	FILE* fp = fopen(argv[3], "wb");
+	if(fp == NULL || fwrite(hdr, hdr_len, 1, fp) != 1 || fwrite(skin, w * h, 1, fp) != 1 ||
+	   (tail > 0 && fwrite(mdl.tdata + mdl.tdim, tail, 1, fp) != 1))
+	{
+		perror(argv[3]);
+		exit(EXIT_FAILURE);
+	}
+	fclose(fp);
+	printf("[NFO][MDL] %s th: %d -> %zu\n", argv[3], mdl.th, h);
+
+	free(hdr);
+	free(skin);
+	free(rgba);
+	csm_quantizer_delete(q);
+	csm_model_reset(&mdl);
+	csm_palette_delete(settings.pal);
+	exit(EXIT_SUCCESS);
+}
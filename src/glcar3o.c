@@ -1,12 +1,51 @@
 #include <chasm/chasm.h>
 #include <error.h>
 
+/* load every model of a resource archive, or only the one named */
+int archive_main(archive* bin, const char* name)
+{
+	/* prefer the archive palette over the loose one */
+	palette* pal = csm_archive_palette_create(bin, NULL);
+	if(pal != NULL)
+	{
+		csm_palette_delete(settings.pal);
+		settings.pal = pal;
+	}
+
+	arena* mem = csm_arena_create(1 << 20);
+	for(size_t i = 0; i < bin->count; i++)
+	{
+		const archive_entry* e = csm_archive_entry_at(bin, i);
+		if(name != NULL ? !csm_archive_name_eq(e->name, name) : !(csm_archive_entry_is(e, ".CAR") || csm_archive_entry_is(e, ".3O")))
+			continue;
+
+		printf("[NFO][BIN] %s\n", e->name);
+		model mdl = csm_archive_model_create_entry(bin, e, mem);
+		csm_model_format_print(mdl.fmt);
+		csm_model_reset(&mdl);
+		csm_arena_reset(mem);
+	}
+	csm_arena_print(mem);
+	csm_arena_delete(mem);
+	return EXIT_SUCCESS;
+}
+
 int main(int argc, char** argv)
 {
 	if(argc <= 1) exit(EXIT_FAILURE);
 
 	/* load default palette */
 	settings.pal = csm_palette_create_fn("assets/chasmpalette.act");
+
+	/* models inside a resource archive */
+	archive* bin = csm_archive_create_fn(argv[1]);
+	if(bin != NULL)
+	{
+		int err = archive_main(bin, argc > 2 ? argv[2] : NULL);
+		csm_archive_delete(bin);
+		csm_palette_delete(settings.pal);
+		exit(err);
+	}
 	if(settings.pal == NULL) exit(EXIT_FAILURE);
 
 	/* load model */
@@ -14,6 +53,29 @@ int main(int argc, char** argv)
 
 	/* print format info */
 	csm_model_format_print(mdl.fmt);
+	if(mdl.fmt == CHASM_FORMAT_CAR)
+		csm_car_layout_print(&mdl.layout);
+
+	/* attach optional .ANI frames and classify static vertices */
+	if(argc > 2)
+		csm_model_ani_create_fn(&mdl, argv[2]);
+	csm_model_motion_create(&mdl);
+	csm_arena_print(mdl.mem);
+
+	/* faces nearest the model origin in the first frame */
+	if(mdl.c3o != NULL)
+	{
+		f32 pos[256 * 3];
+		anim_output out = { .pos = pos, .tick = CSM_ANIM_NONE };
+		csm_anim_eval(&mdl, 0, 0, 1, &out);
+		bvh* b = csm_model_bvh_create(&mdl, pos);
+		csm_bvh_print(b);
+		bvh_hit hit = csm_bvh_closest(b, pos, (f32[3]){ 0, 0, 0 }, 0);
+		if(hit.hit)
+			printf("[NFO][BVH] closest to origin: face %zu group %u flags 0x%02x distance %.2f\n",
+			       hit.face, mdl.c3o->faces[hit.face].conf.group, mdl.c3o->faces[hit.face].conf.flags, hit.t);
+		csm_bvh_delete(b);
+	}
 
 	/* clean up model and palette */
 	if(mdl.fmt != CHASM_FORMAT_NONE)